@@ -0,0 +1,304 @@
+#include "bench.h"
+#include "blend.h"
+#include "compositor.h"
+#include "console.h"
+#include "heap.h"
+#include "smp.h"
+#include "timer.h"
+#include <stddef.h>
+
+static void bench_print_fps(const char *label, uint32_t frames,
+                            uint64_t ticks) {
+  uint64_t freq = timer_frequency();
+  if (!ticks)
+    ticks = 1;
+  uint64_t fps_x10 = (uint64_t)frames * freq * 10 / ticks;
+
+  console_print(label);
+  console_print_dec(fps_x10 / 10);
+  console_print(".");
+  console_print_dec(fps_x10 % 10);
+  console_print(" FPS (");
+  console_print_dec(timer_ticks_to_ns(ticks / frames) / 1000);
+  console_print(" us/frame)\n");
+}
+
+void bench_scanout(uint32_t frames) {
+  int w = (int)console_get_fb_width();
+  int h = (int)console_get_fb_height();
+  if (!w || !h || !frames)
+    return;
+
+  uint32_t *src = (uint32_t *)malloc((size_t)w * h * 4);
+  if (!src) {
+    console_print("bench: Out of memory\n");
+    return;
+  }
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      src[y * w + x] = ((x & 0xFF) << 16) | ((y & 0xFF) << 8) | 0x40;
+    }
+  }
+
+  uint64_t start = timer_read_counter();
+  for (uint32_t f = 0; f < frames; f++) {
+    for (int y = 0; y < h; y++) {
+      for (int x = 0; x < w; x++) {
+        put_pixel(x, y, src[y * w + x]);
+      }
+    }
+  }
+  uint64_t pixel_ticks = timer_read_counter() - start;
+
+  start = timer_read_counter();
+  for (uint32_t f = 0; f < frames; f++) {
+    fb_blit_rect(0, 0, w, h, src, w);
+  }
+  uint64_t blit_ticks = timer_read_counter() - start;
+
+  free(src);
+  console_clear();
+
+  console_print("Scanout ");
+  console_print_dec(w);
+  console_print("x");
+  console_print_dec(h);
+  console_print(", ");
+  console_print_dec(frames);
+  console_print(" frames\n");
+  bench_print_fps("  put_pixel:    ", frames, pixel_ticks);
+  bench_print_fps("  fb_blit_rect: ", frames, blit_ticks);
+}
+
+#define BENCH_BLEND_PIXELS (1920 * 64)
+
+static void bench_print_rate(const char *label, uint64_t pixels,
+                             uint64_t ticks) {
+  uint64_t ns = timer_ticks_to_ns(ticks);
+  if (!ns)
+    ns = 1;
+  console_print(label);
+  console_print_dec(pixels * 1000 / ns);
+  console_print(" Mpix/s\n");
+}
+
+static uint32_t bench_verify_blend(void) {
+  uint32_t src[64], dst[64], ref[64];
+  uint32_t mismatches = 0;
+
+  for (uint32_t alpha = 0; alpha < 256; alpha++) {
+    for (int i = 0; i < 64; i++) {
+      src[i] = (uint32_t)(i * 0x04030201u) ^ (alpha << 8);
+      dst[i] = ~src[i] * 0x9E3779B1u;
+      if (i < 4) {
+        src[i] = i & 1 ? 0xFFFFFFFF : 0;
+        dst[i] = i & 2 ? 0xFFFFFFFF : 0;
+      }
+      ref[i] = dst[i];
+    }
+    blend_row(dst, src, 64, (uint8_t)alpha);
+    if (alpha != 0 && alpha != 255) {
+      blend_row_scalar(ref, src, 64, (uint8_t)alpha);
+    } else if (alpha == 255) {
+      for (int i = 0; i < 64; i++)
+        ref[i] = src[i];
+    }
+    for (int i = 0; i < 64; i++) {
+      if (dst[i] != ref[i])
+        mismatches++;
+    }
+  }
+  return mismatches;
+}
+
+static uint32_t bench_premultiply(uint32_t seed) {
+  uint32_t a = seed >> 24;
+  return blend_scale_pixel(seed & 0xFFFFFF, (uint8_t)a) | (a << 24);
+}
+
+ 
+ 
+static uint32_t bench_verify_over(void) {
+  uint32_t src[64], dst[64], ref[64];
+  uint32_t mismatches = 0;
+
+  for (uint32_t alpha = 0; alpha < 256; alpha++) {
+    for (int i = 0; i < 64; i++) {
+      uint32_t seed = (uint32_t)(i * 0x9E3779B1u) ^ (alpha * 0x01010101u);
+      if (i < 16)
+        seed |= 0xFF000000;
+      else if (i < 32)
+        seed &= 0x00FFFFFF;
+      src[i] = bench_premultiply(seed);
+      dst[i] = ~seed * 0x04030201u;
+      ref[i] = dst[i];
+    }
+    blend_over_row(dst, src, 64, (uint8_t)alpha);
+    if (alpha != 0)
+      blend_over_row_scalar(ref, src, 64, (uint8_t)alpha);
+    for (int i = 0; i < 64; i++) {
+      if (dst[i] != ref[i])
+        mismatches++;
+    }
+  }
+  return mismatches;
+}
+
+void bench_blend(uint32_t iterations) {
+  if (!iterations)
+    return;
+
+  uint32_t *src = (uint32_t *)malloc(BENCH_BLEND_PIXELS * 4);
+  uint32_t *dst = (uint32_t *)malloc(BENCH_BLEND_PIXELS * 4);
+  if (!src || !dst) {
+    console_print("bench: Out of memory\n");
+    free(src);
+    free(dst);
+    return;
+  }
+  for (uint32_t i = 0; i < BENCH_BLEND_PIXELS; i++) {
+    src[i] = i * 2654435761u;
+    dst[i] = ~src[i];
+  }
+
+  uint64_t pixels = (uint64_t)BENCH_BLEND_PIXELS * iterations;
+
+  uint64_t start = timer_read_counter();
+  for (uint32_t it = 0; it < iterations; it++)
+    blend_row_scalar(dst, src, BENCH_BLEND_PIXELS, 120);
+  uint64_t scalar_ticks = timer_read_counter() - start;
+
+  start = timer_read_counter();
+  for (uint32_t it = 0; it < iterations; it++)
+    blend_row(dst, src, BENCH_BLEND_PIXELS, 120);
+  uint64_t simd_ticks = timer_read_counter() - start;
+
+  start = timer_read_counter();
+  for (uint32_t it = 0; it < iterations; it++)
+    blend_row(dst, src, BENCH_BLEND_PIXELS, 255);
+  uint64_t copy_ticks = timer_read_counter() - start;
+
+  for (uint32_t i = 0; i < BENCH_BLEND_PIXELS; i++)
+    src[i] = bench_premultiply(src[i]);
+
+  start = timer_read_counter();
+  for (uint32_t it = 0; it < iterations; it++)
+    blend_over_row_scalar(dst, src, BENCH_BLEND_PIXELS, 255);
+  uint64_t over_scalar_ticks = timer_read_counter() - start;
+
+  start = timer_read_counter();
+  for (uint32_t it = 0; it < iterations; it++)
+    blend_over_row(dst, src, BENCH_BLEND_PIXELS, 255);
+  uint64_t over_ticks = timer_read_counter() - start;
+
+  free(src);
+  free(dst);
+
+  console_print("Blend ");
+  console_print_dec(BENCH_BLEND_PIXELS);
+  console_print(" px x ");
+  console_print_dec(iterations);
+  console_print("\n");
+  bench_print_rate("  scalar alpha=120: ", pixels, scalar_ticks);
+  bench_print_rate("  NEON alpha=120:   ", pixels, simd_ticks);
+  bench_print_rate("  opaque copy:      ", pixels, copy_ticks);
+  bench_print_rate("  scalar premul:    ", pixels, over_scalar_ticks);
+  bench_print_rate("  NEON premul:      ", pixels, over_ticks);
+
+  uint32_t bad = bench_verify_blend() + bench_verify_over();
+  console_print(bad ? "  verify: " : "  verify: OK\n");
+  if (bad) {
+    console_print_dec(bad);
+    console_print(" mismatches against the scalar reference\n");
+  }
+}
+
+#define BENCH_COMPOSE_WINDOWS 4
+#define BENCH_COMPOSE_RUNS 16
+#define CURSOR_OFFSCREEN 1000
+
+static uint64_t bench_compose_run(uint32_t cpus, uint32_t frames, int w,
+                                  int h) {
+  compositor_set_cpus(cpus);
+  compositor_damage(0, 0, w, h);
+  compositor_render(-CURSOR_OFFSCREEN, -CURSOR_OFFSCREEN);
+
+  uint64_t start = timer_read_counter();
+  for (uint32_t f = 0; f < frames; f++) {
+    compositor_damage(0, 0, w, h);
+    compositor_render(-CURSOR_OFFSCREEN, -CURSOR_OFFSCREEN);
+  }
+  return timer_read_counter() - start;
+}
+
+void bench_compose(uint32_t frames) {
+  if (!frames)
+    return;
+
+  compositor_init();
+  int w = compositor_get_width();
+  int h = compositor_get_height();
+  if (!w || !h)
+    return;
+
+  window_t *wins[BENCH_COMPOSE_WINDOWS + 1];
+  wins[0] = compositor_create_window(0, 0, w, h, 0);
+  if (wins[0]) {
+    for (int y = 0; y < h; y++)
+      window_fill_rect(wins[0], 0, y, w, 1, (uint32_t)(y * 255 / h) << 8);
+  }
+  for (int i = 1; i <= BENCH_COMPOSE_WINDOWS; i++) {
+    int ww = w / 2;
+    int wh = h / 2;
+    wins[i] = compositor_create_window(i * w / 10, i * h / 10, ww, wh, i);
+    if (!wins[i])
+      continue;
+    wins[i]->alpha = 200;
+    window_clear(wins[i], 0x304060u * (uint32_t)i);
+  }
+
+  uint32_t ncpus = smp_num_cpus();
+  uint64_t ticks[BENCH_COMPOSE_RUNS];
+  uint32_t tested[BENCH_COMPOSE_RUNS];
+  uint32_t runs = 0;
+  for (uint32_t cpus = 1; cpus <= ncpus; cpus *= 2) {
+    tested[runs] = cpus;
+    ticks[runs++] = bench_compose_run(cpus, frames, w, h);
+    if (cpus < ncpus && cpus * 2 > ncpus) {
+      tested[runs] = ncpus;
+      ticks[runs++] = bench_compose_run(ncpus, frames, w, h);
+    }
+  }
+
+  for (int i = 0; i <= BENCH_COMPOSE_WINDOWS; i++) {
+    if (wins[i])
+      compositor_destroy_window(wins[i]);
+  }
+  compositor_set_cpus(0);
+  compositor_shutdown();
+  console_clear();
+
+  console_print("Compose ");
+  console_print_dec(w);
+  console_print("x");
+  console_print_dec(h);
+  console_print(", ");
+  console_print_dec(BENCH_COMPOSE_WINDOWS + 1);
+  console_print(" windows, ");
+  console_print_dec(frames);
+  console_print(" full-screen frames\n");
+  for (uint32_t i = 0; i < runs; i++) {
+    console_print("  ");
+    console_print_dec(tested[i]);
+    console_print(tested[i] == 1 ? " CPU:  " : " CPUs: ");
+    console_print_dec(timer_ticks_to_ns(ticks[i] / frames) / 1000);
+    console_print(" us/frame, speedup ");
+    uint64_t speedup_x100 = ticks[i] ? ticks[0] * 100 / ticks[i] : 0;
+    console_print_dec(speedup_x100 / 100);
+    console_print(".");
+    if (speedup_x100 % 100 < 10)
+      console_print("0");
+    console_print_dec(speedup_x100 % 100);
+    console_print("x\n");
+  }
+}
@@ -0,0 +1,18 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+ 
+ 
+void bench_scanout(uint32_t frames);
+
+ 
+ 
+void bench_blend(uint32_t iterations);
+
+ 
+ 
+void bench_compose(uint32_t frames);
+
+#endif
@@ -0,0 +1,176 @@
+#include "blend.h"
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+
+ 
+ 
+ 
+static inline uint8x16_t blend16(uint8x16_t s, uint8x16_t d, uint8x8_t a,
+                                 uint8x8_t ia) {
+  uint16x8_t lo = vmull_u8(vget_low_u8(s), a);
+  uint16x8_t hi = vmull_u8(vget_high_u8(s), a);
+  lo = vmlal_u8(lo, vget_low_u8(d), ia);
+  hi = vmlal_u8(hi, vget_high_u8(d), ia);
+  return vcombine_u8(vraddhn_u16(lo, vrshrq_n_u16(lo, 8)),
+                     vraddhn_u16(hi, vrshrq_n_u16(hi, 8)));
+}
+
+ 
+static inline uint8x16_t scale16(uint8x16_t s, uint8x16_t a) {
+  uint16x8_t lo = vmull_u8(vget_low_u8(s), vget_low_u8(a));
+  uint16x8_t hi = vmull_high_u8(s, a);
+  return vcombine_u8(vraddhn_u16(lo, vrshrq_n_u16(lo, 8)),
+                     vraddhn_u16(hi, vrshrq_n_u16(hi, 8)));
+}
+
+ 
+ 
+ 
+static inline uint8x16_t over16(uint8x16_t s, uint8x16_t d,
+                                uint8x16_t alpha_lanes) {
+  uint8x16_t ia = vqtbl1q_u8(vmvnq_u8(s), alpha_lanes);
+  return vqaddq_u8(s, scale16(d, ia));
+}
+
+static const uint8_t blend_alpha_lanes[16] = {3,  3,  3,  3,  7,  7,  7,  7,
+                                              11, 11, 11, 11, 15, 15, 15, 15};
+#endif
+
+void blend_row_scalar(uint32_t *dst, const uint32_t *src, uint32_t n,
+                      uint8_t alpha) {
+  for (uint32_t i = 0; i < n; i++) {
+    dst[i] = blend_pixel(src[i], dst[i], alpha);
+  }
+}
+
+void blend_copy_row(uint32_t *dst, const uint32_t *src, uint32_t n) {
+#ifdef __ARM_NEON
+  while (n >= 16) {
+    uint32x4_t a = vld1q_u32(src);
+    uint32x4_t b = vld1q_u32(src + 4);
+    uint32x4_t c = vld1q_u32(src + 8);
+    uint32x4_t d = vld1q_u32(src + 12);
+    vst1q_u32(dst, a);
+    vst1q_u32(dst + 4, b);
+    vst1q_u32(dst + 8, c);
+    vst1q_u32(dst + 12, d);
+    src += 16;
+    dst += 16;
+    n -= 16;
+  }
+#endif
+  while (n--)
+    *dst++ = *src++;
+}
+
+void blend_row(uint32_t *dst, const uint32_t *src, uint32_t n, uint8_t alpha) {
+  if (alpha == 255) {
+    blend_copy_row(dst, src, n);
+    return;
+  }
+  if (alpha == 0)
+    return;
+
+#ifdef __ARM_NEON
+  uint8x8_t va = vdup_n_u8(alpha);
+  uint8x8_t vi = vdup_n_u8(255 - alpha);
+
+  while (n >= 16) {
+    uint8_t *d8 = (uint8_t *)dst;
+    const uint8_t *s8 = (const uint8_t *)src;
+    uint8x16_t r0 = blend16(vld1q_u8(s8), vld1q_u8(d8), va, vi);
+    uint8x16_t r1 = blend16(vld1q_u8(s8 + 16), vld1q_u8(d8 + 16), va, vi);
+    uint8x16_t r2 = blend16(vld1q_u8(s8 + 32), vld1q_u8(d8 + 32), va, vi);
+    uint8x16_t r3 = blend16(vld1q_u8(s8 + 48), vld1q_u8(d8 + 48), va, vi);
+    vst1q_u8(d8, r0);
+    vst1q_u8(d8 + 16, r1);
+    vst1q_u8(d8 + 32, r2);
+    vst1q_u8(d8 + 48, r3);
+    src += 16;
+    dst += 16;
+    n -= 16;
+  }
+  while (n >= 4) {
+    uint8_t *d8 = (uint8_t *)dst;
+    vst1q_u8(d8, blend16(vld1q_u8((const uint8_t *)src), vld1q_u8(d8), va, vi));
+    src += 4;
+    dst += 4;
+    n -= 4;
+  }
+#endif
+
+  blend_row_scalar(dst, src, n, alpha);
+}
+
+void blend_over_row_scalar(uint32_t *dst, const uint32_t *src, uint32_t n,
+                           uint8_t alpha) {
+  if (alpha == 255) {
+    for (uint32_t i = 0; i < n; i++)
+      dst[i] = blend_over_pixel(src[i], dst[i]);
+    return;
+  }
+  for (uint32_t i = 0; i < n; i++)
+    dst[i] = blend_over_pixel(blend_scale_pixel(src[i], alpha), dst[i]);
+}
+
+void blend_over_row(uint32_t *dst, const uint32_t *src, uint32_t n,
+                    uint8_t alpha) {
+  if (alpha == 0)
+    return;
+
+#ifdef __ARM_NEON
+  uint8x16_t lanes = vld1q_u8(blend_alpha_lanes);
+  uint8x16_t va = vdupq_n_u8(alpha);
+
+   
+   
+  while (n >= 16) {
+    uint8_t *d8 = (uint8_t *)dst;
+    const uint8_t *s8 = (const uint8_t *)src;
+    uint8x16_t s0 = vld1q_u8(s8);
+    uint8x16_t s1 = vld1q_u8(s8 + 16);
+    uint8x16_t s2 = vld1q_u8(s8 + 32);
+    uint8x16_t s3 = vld1q_u8(s8 + 48);
+    uint32x4_t a = vandq_u32(
+        vandq_u32(vreinterpretq_u32_u8(s0), vreinterpretq_u32_u8(s1)),
+        vandq_u32(vreinterpretq_u32_u8(s2), vreinterpretq_u32_u8(s3)));
+    uint32x4_t o = vorrq_u32(
+        vorrq_u32(vreinterpretq_u32_u8(s0), vreinterpretq_u32_u8(s1)),
+        vorrq_u32(vreinterpretq_u32_u8(s2), vreinterpretq_u32_u8(s3)));
+
+    if (alpha == 255 && vminvq_u32(vshrq_n_u32(a, 24)) == 255) {
+      vst1q_u8(d8, s0);
+      vst1q_u8(d8 + 16, s1);
+      vst1q_u8(d8 + 32, s2);
+      vst1q_u8(d8 + 48, s3);
+    } else if (vmaxvq_u32(vshrq_n_u32(o, 24)) != 0) {
+      if (alpha != 255) {
+        s0 = scale16(s0, va);
+        s1 = scale16(s1, va);
+        s2 = scale16(s2, va);
+        s3 = scale16(s3, va);
+      }
+      vst1q_u8(d8, over16(s0, vld1q_u8(d8), lanes));
+      vst1q_u8(d8 + 16, over16(s1, vld1q_u8(d8 + 16), lanes));
+      vst1q_u8(d8 + 32, over16(s2, vld1q_u8(d8 + 32), lanes));
+      vst1q_u8(d8 + 48, over16(s3, vld1q_u8(d8 + 48), lanes));
+    }
+    src += 16;
+    dst += 16;
+    n -= 16;
+  }
+  while (n >= 4) {
+    uint8_t *d8 = (uint8_t *)dst;
+    uint8x16_t s0 = vld1q_u8((const uint8_t *)src);
+    if (alpha != 255)
+      s0 = scale16(s0, va);
+    vst1q_u8(d8, over16(s0, vld1q_u8(d8), lanes));
+    src += 4;
+    dst += 4;
+    n -= 4;
+  }
+#endif
+
+  blend_over_row_scalar(dst, src, n, alpha);
+}
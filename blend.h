@@ -0,0 +1,67 @@
+#ifndef BLEND_H
+#define BLEND_H
+
+#include <stdint.h>
+
+ 
+static inline uint32_t div255(uint32_t t) {
+  t += 128;
+  return (t + (t >> 8)) >> 8;
+}
+
+static inline uint32_t blend_scale_pixel(uint32_t src, uint8_t alpha) {
+  uint32_t out = 0;
+  for (int shift = 0; shift < 32; shift += 8)
+    out |= div255(((src >> shift) & 0xFF) * alpha) << shift;
+  return out;
+}
+
+ 
+ 
+ 
+static inline uint32_t blend_over_pixel(uint32_t src, uint32_t dst) {
+  uint32_t ia = 255 - (src >> 24);
+  if (ia == 0)
+    return src;
+  uint32_t out = 0;
+  for (int shift = 0; shift < 32; shift += 8) {
+    uint32_t s = (src >> shift) & 0xFF;
+    uint32_t d = (dst >> shift) & 0xFF;
+    out |= (s + div255(d * ia)) << shift;
+  }
+  return out;
+}
+
+static inline uint32_t blend_pixel(uint32_t src, uint32_t dst, uint8_t alpha) {
+  uint32_t ia = 255 - alpha;
+  uint32_t out = 0;
+  for (int shift = 0; shift < 32; shift += 8) {
+    uint32_t s = (src >> shift) & 0xFF;
+    uint32_t d = (dst >> shift) & 0xFF;
+    out |= div255(s * alpha + d * ia) << shift;
+  }
+  return out;
+}
+
+ 
+static inline void fpsimd_enable(void) {
+  uint64_t cpacr;
+  __asm__ volatile("mrs %0, cpacr_el1" : "=r"(cpacr));
+  __asm__ volatile("msr cpacr_el1, %0\n"
+                   "isb" ::"r"(cpacr | (3ull << 20)));
+}
+
+void blend_row(uint32_t *dst, const uint32_t *src, uint32_t n, uint8_t alpha);
+void blend_row_scalar(uint32_t *dst, const uint32_t *src, uint32_t n,
+                      uint8_t alpha);
+void blend_copy_row(uint32_t *dst, const uint32_t *src, uint32_t n);
+
+ 
+ 
+ 
+void blend_over_row(uint32_t *dst, const uint32_t *src, uint32_t n,
+                    uint8_t alpha);
+void blend_over_row_scalar(uint32_t *dst, const uint32_t *src, uint32_t n,
+                           uint8_t alpha);
+
+#endif
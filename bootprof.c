@@ -0,0 +1,64 @@
+#include "bootprof.h"
+#include "console.h"
+#include "string.h"
+#include "timer.h"
+
+struct boot_phase {
+  const char *name;
+  uint64_t stamp;
+};
+
+static struct boot_phase phases[BOOTPROF_MAX_PHASES];
+static uint32_t phase_count = 0;
+static uint64_t boot_entry = 0;
+
+void bootprof_start(void) {
+  boot_entry = timer_read_counter();
+  phase_count = 0;
+}
+
+void bootprof_mark(const char *phase) {
+  if (phase_count >= BOOTPROF_MAX_PHASES)
+    return;
+  phases[phase_count].name = phase;
+  phases[phase_count].stamp = timer_read_counter();
+  phase_count++;
+}
+
+static void bootprof_print_us(uint64_t ticks, uint32_t width) {
+  uint64_t us = timer_ticks_to_ns(ticks) / 1000;
+  uint32_t digits = 1;
+  for (uint64_t n = us; n >= 10; n /= 10)
+    digits++;
+  while (width-- > digits)
+    console_print(" ");
+  console_print_dec(us);
+}
+
+ 
+ 
+static void bootprof_row(const char *name, uint64_t ticks, uint64_t total) {
+  console_print("  ");
+  console_print(name);
+  for (uint32_t n = (uint32_t)k_strlen(name); n < 14; n++)
+    console_print(" ");
+  bootprof_print_us(ticks, 10);
+  bootprof_print_us(total, 10);
+  console_print("\n");
+}
+
+ 
+ 
+ 
+void bootprof_print(void) {
+  console_print("Boot timeline (us):\n");
+  console_print("  PHASE               TIME     TOTAL\n");
+  bootprof_row("firmware", boot_entry, boot_entry);
+
+  uint64_t prev = boot_entry;
+  for (uint32_t i = 0; i < phase_count; i++) {
+    bootprof_row(phases[i].name, phases[i].stamp - prev,
+                 phases[i].stamp - boot_entry);
+    prev = phases[i].stamp;
+  }
+}
@@ -0,0 +1,17 @@
+#ifndef BOOTPROF_H
+#define BOOTPROF_H
+
+#include <stdint.h>
+
+#define BOOTPROF_MAX_PHASES 24
+
+ 
+ 
+ 
+void bootprof_start(void);
+void bootprof_mark(const char *phase);
+
+ 
+void bootprof_print(void);
+
+#endif
@@ -1,7 +1,14 @@
 #include "compositor.h"
+#include "blend.h"
 #include "console.h"
+#include "display.h"
+#include "glyph.h"
 #include "heap.h"
+#include "irq.h"
+#include "process.h"
+#include "smp.h"
 #include "string.h"
+#include "timer.h"
 
  
 static window_t *window_list = NULL;
@@ -10,31 +17,284 @@ static window_t *window_list = NULL;
 static uint32_t *screen_backbuffer = NULL;
 static int screen_w = 0;
 static int screen_h = 0;
+static int screen_stride = 0;
 
 static int next_win_id = 1;
+static int window_count = 0;
 
-extern const uint8_t font_8x16[95][16];
+ 
+ 
+static window_t **frame_windows = NULL;
+static rect_t *occluders = NULL;
+static int frame_capacity = 0;
+static int frame_count = 0;
+
+ 
+ 
+static rect_t *frame_tiles = NULL;
+static uint64_t frame_painted = 0;
+static uint32_t compositor_cpus = 0;
+
+static region_t screen_damage;
+static region_t paint_region;
+
+ 
+ 
+static region_t damage_history[DISPLAY_MAX_SURFACES - 1];
+static int history_head = 0;
+static int history_count = 0;
+
+static struct compositor_stats stats;
+
+ 
+ 
+ 
+static task_t *compositor_task = NULL;
+static volatile int compositor_running = 0;
+static volatile int frame_requested = 0;
+static volatile int frame_cursor_x = 0;
+static volatile int frame_cursor_y = 0;
+static uint32_t refresh_hz = COMPOSITOR_DEFAULT_HZ;
+static uint64_t frame_period = 0;
+static uint64_t last_frame_start = 0;
+
+#define BG_COLOR 0x222222
+#define CURSOR_SIZE 12
+#define COMPOSITOR_TILE 128
+#define COMPOSITOR_PARALLEL_MIN (COMPOSITOR_TILE * COMPOSITOR_TILE * 4)
+#define COMPOSITOR_OCCLUDER_RECTS 4
+
+static void compositor_init_cursor(void) {
+  static uint32_t arrow[CURSOR_SIZE * CURSOR_SIZE];
+  for (int i = 0; i < CURSOR_SIZE; i++) {
+    for (int j = 0; j < CURSOR_SIZE; j++) {
+      uint32_t pixel = 0;
+      if (j < CURSOR_SIZE - i) {
+        int edge = j == 0 || i == 0 || j == CURSOR_SIZE - 1 - i;
+        pixel = edge ? 0xFF000000 : 0xFFFFFFFF;
+      }
+      arrow[i * CURSOR_SIZE + j] = pixel;
+    }
+  }
+  display_cursor_set(arrow, CURSOR_SIZE, CURSOR_SIZE, 0, 0);
+}
 
 void compositor_init(void) {
-  screen_w = console_get_fb_width();
-  screen_h = console_get_fb_height();
+  screen_w = (int)display_width();
+  screen_h = (int)display_height();
 
    
-  screen_backbuffer = (uint32_t *)malloc(screen_w * screen_h * 4);
-  if (!screen_backbuffer) {
-    console_print("COMPOSITOR: Failed to allocate backbuffer!\n");
+  if (!display_open(DISPLAY_MAX_SURFACES)) {
+    console_print("COMPOSITOR: Failed to allocate display surfaces!\n");
     return;
   }
-  k_memset(screen_backbuffer, 0, screen_w * screen_h * 4);
+  screen_stride = (int)display_stride();
+
+  int tiles_x = (screen_w + COMPOSITOR_TILE - 1) / COMPOSITOR_TILE;
+  int tiles_y = (screen_h + COMPOSITOR_TILE - 1) / COMPOSITOR_TILE;
+  if (frame_tiles)
+    free(frame_tiles);
+  frame_tiles = (rect_t *)malloc(tiles_x * tiles_y * sizeof(rect_t));
+  if (!frame_tiles) {
+    console_print("COMPOSITOR: Failed to allocate tile list!\n");
+    display_close();
+    return;
+  }
+  screen_backbuffer = NULL;
+  history_head = 0;
+  history_count = 0;
+
+  region_init(&screen_damage);
+  region_add(&screen_damage, rect_make(0, 0, screen_w, screen_h));
+  k_memset(&stats, 0, sizeof(stats));
+  compositor_init_cursor();
 
   console_print("COMPOSITOR: Initialized with resolution ");
   console_print_dec(screen_w);
   console_print("x");
   console_print_dec(screen_h);
+  console_print(", ");
+  console_print_dec(display_surface_count());
+  console_print(" surface(s) via ");
+  console_print(display_backend_name());
   console_print("\n");
 }
 
+ 
+ 
+ 
+static void compositor_request_frame(void) {
+  stats.invalidations++;
+  if (frame_requested)
+    return;
+  frame_requested = 1;
+  if (compositor_running &&
+      timer_read_counter() - last_frame_start >= frame_period)
+    process_wake(compositor_task);
+}
+
+ 
+static void compositor_tick(void) {
+  stats.ticks++;
+  if (frame_requested)
+    process_wake(compositor_task);
+}
+
+static void compositor_account_frame(uint64_t ticks) {
+  stats.timed_frames++;
+  stats.frame_ticks += ticks;
+  stats.last_frame_ticks = ticks;
+  if (ticks > stats.max_frame_ticks)
+    stats.max_frame_ticks = ticks;
+  if (ticks > frame_period)
+    stats.missed_frames++;
+
+   
+  uint64_t bucket = frame_period ? ticks * 4 / frame_period : 0;
+  if (bucket >= COMPOSITOR_FRAME_BUCKETS)
+    bucket = COMPOSITOR_FRAME_BUCKETS - 1;
+  stats.frame_hist[bucket]++;
+}
+
+static void compositor_thread(void) {
+  for (;;) {
+    uint64_t flags = local_irq_save();
+    if (!compositor_running || !frame_requested) {
+      current_task->state = TASK_BLOCKED;
+      local_irq_restore(flags);
+      schedule();
+      continue;
+    }
+    local_irq_restore(flags);
+
+    uint64_t painted = stats.frames - stats.idle_frames;
+    last_frame_start = timer_read_counter();
+    compositor_render(frame_cursor_x, frame_cursor_y);
+    if (stats.frames - stats.idle_frames != painted)
+      compositor_account_frame(timer_read_counter() - last_frame_start);
+  }
+}
+
+void compositor_start(void) {
+  if (!display_surface_count() || compositor_running)
+    return;
+
+  if (!compositor_task) {
+    compositor_task = process_create(compositor_thread, "compositor");
+    if (!compositor_task) {
+      console_print("COMPOSITOR: Failed to create compositor task!\n");
+      return;
+    }
+  }
+
+  frame_period = timer_frequency() / refresh_hz;
+  last_frame_start = timer_read_counter() - frame_period;
+  compositor_running = 1;
+  timer_register_tick(compositor_tick);
+  timer_set_rate(refresh_hz);
+  compositor_request_frame();
+}
+
+void compositor_shutdown(void) {
+  if (compositor_running) {
+    compositor_running = 0;
+    timer_unregister_tick(compositor_tick);
+    timer_set_rate(0);
+  }
+  frame_requested = 0;
+  display_close();
+  screen_backbuffer = NULL;
+}
+
+void compositor_set_refresh(uint32_t hz) {
+  if (!hz)
+    return;
+  refresh_hz = hz;
+  frame_period = timer_frequency() / hz;
+  if (compositor_running)
+    timer_set_rate(hz);
+}
+
+uint32_t compositor_get_refresh(void) { return refresh_hz; }
+
+void compositor_commit(int cursor_x, int cursor_y) {
+  frame_cursor_x = cursor_x;
+  frame_cursor_y = cursor_y;
+  compositor_request_frame();
+}
+
+ 
+ 
+ 
+void compositor_wait_frame(void) {
+  yield();
+  if (!compositor_running)
+    return;
+
+  uint64_t tick = stats.ticks;
+  while (compositor_running &&
+         __atomic_load_n(&stats.ticks, __ATOMIC_RELAXED) == tick) {
+    uint64_t flags = local_irq_save();
+    if (__atomic_load_n(&stats.ticks, __ATOMIC_RELAXED) == tick)
+      __asm__ volatile("wfi");
+    local_irq_restore(flags);
+  }
+  yield();
+}
+
+static int compositor_reserve(int count) {
+  if (count <= frame_capacity)
+    return 0;
+
+  int capacity = frame_capacity ? frame_capacity * 2 : 16;
+  while (capacity < count)
+    capacity *= 2;
+  window_t **wins = (window_t **)malloc(capacity * sizeof(window_t *));
+  rect_t *rects =
+      (rect_t *)malloc(capacity * COMPOSITOR_OCCLUDER_RECTS * sizeof(rect_t));
+  if (!wins || !rects) {
+    if (wins)
+      free(wins);
+    if (rects)
+      free(rects);
+    return -1;
+  }
+
+  if (frame_windows)
+    free(frame_windows);
+  if (occluders)
+    free(occluders);
+  frame_windows = wins;
+  occluders = rects;
+  frame_capacity = capacity;
+  return 0;
+}
+
+ 
+ 
+ 
+static void window_link(window_t *win) {
+  window_t **link = &window_list;
+  while (*link && (*link)->z_index < win->z_index)
+    link = &(*link)->next;
+  win->next = *link;
+  rcu_assign_pointer(*link, win);
+}
+
+static int window_unlink(window_t *win) {
+  window_t **link = &window_list;
+  while (*link && *link != win)
+    link = &(*link)->next;
+  if (!*link)
+    return -1;
+  rcu_assign_pointer(*link, win->next);
+  return 0;
+}
+
 window_t *compositor_create_window(int x, int y, int w, int h, int z_index) {
+  if (compositor_reserve(window_count + 1) < 0)
+    return NULL;
+
   window_t *win = (window_t *)malloc(sizeof(window_t));
   if (!win)
     return NULL;
@@ -47,223 +307,622 @@ window_t *compositor_create_window(int x, int y, int w, int h, int z_index) {
   win->z_index = z_index;
   win->visible = 1;
   win->alpha = 255;
+  region_init(&win->damage);
+  region_init(&win->clip);
+  region_init(&win->opaque);
+  region_add(&win->opaque, rect_make(0, 0, w, h));
+  win->corner_radius = 0;
+  k_memset(&win->shown, 0, sizeof(win->shown));
 
   win->buffer = (uint32_t *)malloc(w * h * 4);
   if (!win->buffer) {
     free(win);
     return NULL;
   }
-  k_memset(win->buffer, 0, w * h * 4);
+  for (int i = 0; i < w * h; i++)
+    win->buffer[i] = ARGB_OPAQUE;
 
-   
-   
-  win->next = window_list;
-  window_list = win;
+  window_link(win);
+  window_count++;
 
   return win;
 }
 
-void compositor_destroy_window(window_t *win) {
-  if (!win)
-    return;
-
-   
-  if (window_list == win) {
-    window_list = win->next;
-  } else {
-    window_t *curr = window_list;
-    while (curr && curr->next != win) {
-      curr = curr->next;
-    }
-    if (curr) {
-      curr->next = win->next;
-    }
-  }
-
+static void window_free_rcu(struct rcu_head *head) {
+  window_t *win = container_of(head, window_t, rcu);
   if (win->buffer)
     free(win->buffer);
   free(win);
 }
 
- 
- 
-static inline uint32_t blend_colors(uint32_t src, uint32_t dst, uint8_t alpha) {
-  if (alpha == 255)
-    return src;
-  if (alpha == 0)
-    return dst;
+void compositor_destroy_window(window_t *win) {
+  if (!win)
+    return;
 
-  uint32_t r_s = (src >> 16) & 0xFF;
-  uint32_t g_s = (src >> 8) & 0xFF;
-  uint32_t b_s = (src) & 0xFF;
+  if (window_unlink(win) < 0)
+    return;
+  window_count--;
 
-  uint32_t r_d = (dst >> 16) & 0xFF;
-  uint32_t g_d = (dst >> 8) & 0xFF;
-  uint32_t b_d = (dst) & 0xFF;
+  if (win->shown.visible)
+    compositor_damage(win->shown.x, win->shown.y, win->shown.width,
+                      win->shown.height);
 
-   
-   
-  uint32_t r = (r_s * alpha + r_d * (255 - alpha)) >> 8;
-  uint32_t g = (g_s * alpha + g_d * (255 - alpha)) >> 8;
-  uint32_t b = (b_s * alpha + b_d * (255 - alpha)) >> 8;
+  call_rcu(&win->rcu, window_free_rcu);
+}
 
-  return (r << 16) | (g << 8) | b;
+void compositor_damage(int x, int y, int w, int h) {
+  region_add(&screen_damage, rect_make(x, y, w, h));
+  compositor_request_frame();
 }
 
-void compositor_render(int cursor_x, int cursor_y) {
-  if (!screen_backbuffer)
+void compositor_get_stats(struct compositor_stats *out) { *out = stats; }
+
+static void print_ratio(uint64_t num, uint64_t den) {
+  uint64_t hundredths = den ? num * 100 / den : 0;
+  console_print_dec(hundredths / 100);
+  console_print(".");
+  if (hundredths % 100 < 10)
+    console_print("0");
+  console_print_dec(hundredths % 100);
+  console_print("x");
+}
+
+void compositor_print_stats(void) {
+  console_print("Frames: ");
+  console_print_dec(stats.frames);
+  console_print(" (idle ");
+  console_print_dec(stats.idle_frames);
+  console_print(")\nDamaged pixels: ");
+  console_print_dec(stats.damaged_pixels);
+  console_print("\nPainted pixels: ");
+  console_print_dec(stats.painted_pixels);
+  console_print("\nOverdraw: ");
+  print_ratio(stats.painted_pixels, stats.damaged_pixels);
+  console_print(" (last frame ");
+  print_ratio(stats.last_painted_pixels, stats.last_damaged_pixels);
+  console_print(")\nRefresh: ");
+  console_print_dec(refresh_hz);
+  console_print(" Hz, ");
+  console_print_dec(stats.ticks);
+  console_print(" ticks, ");
+  console_print_dec(stats.invalidations);
+  console_print(" invalidations\n");
+  if (!stats.timed_frames)
     return;
 
-   
-   
-   
-   
-  for (int i = 0; i < screen_w * screen_h; i++) {
-    screen_backbuffer[i] = 0x222222;  
+  console_print("Frame time (us): last ");
+  console_print_dec(timer_ticks_to_ns(stats.last_frame_ticks) / 1000);
+  console_print(", avg ");
+  console_print_dec(
+      timer_ticks_to_ns(stats.frame_ticks / stats.timed_frames) / 1000);
+  console_print(", max ");
+  console_print_dec(timer_ticks_to_ns(stats.max_frame_ticks) / 1000);
+  console_print(", missed ");
+  console_print_dec(stats.missed_frames);
+  console_print("\n ");
+  for (uint32_t b = 0; b < COMPOSITOR_FRAME_BUCKETS; b++) {
+    if (!stats.frame_hist[b])
+      continue;
+    if (b == COMPOSITOR_FRAME_BUCKETS - 1) {
+      console_print(" >=");
+      console_print_dec(b * 25);
+    } else {
+      console_print(" <");
+      console_print_dec(b * 25 + 25);
+    }
+    console_print("%:");
+    console_print_dec(stats.frame_hist[b]);
   }
+  console_print("\n");
+}
 
-   
-   
-   
-   
-   
-   
-   
+ 
+ 
+ 
+static void compositor_track_window(window_t *w) {
+  int moved = w->x != w->shown.x || w->y != w->shown.y ||
+              w->width != w->shown.width || w->height != w->shown.height ||
+              w->z_index != w->shown.z_index ||
+              w->visible != w->shown.visible || w->alpha != w->shown.alpha;
 
-#define MAX_WINDOWS 32
-  window_t *wins[MAX_WINDOWS];
-  int count = 0;
-  window_t *curr = window_list;
-  while (curr && count < MAX_WINDOWS) {
-    wins[count++] = curr;
-    curr = curr->next;
-  }
+  if (moved) {
+    if (w->shown.visible)
+      compositor_damage(w->shown.x, w->shown.y, w->shown.width,
+                        w->shown.height);
+    if (w->visible)
+      compositor_damage(w->x, w->y, w->width, w->height);
 
-   
-  for (int i = 0; i < count - 1; i++) {
-    for (int j = 0; j < count - i - 1; j++) {
-      if (wins[j]->z_index > wins[j + 1]->z_index) {
-        window_t *temp = wins[j];
-        wins[j] = wins[j + 1];
-        wins[j + 1] = temp;
-      }
-    }
+    w->shown.x = w->x;
+    w->shown.y = w->y;
+    w->shown.width = w->width;
+    w->shown.height = w->height;
+    w->shown.z_index = w->z_index;
+    w->shown.visible = w->visible;
+    w->shown.alpha = w->alpha;
+  } else if (w->visible) {
+    region_add_region(&screen_damage, &w->damage, w->x, w->y);
   }
+  region_clear(&w->damage);
+}
 
-   
-  for (int i = 0; i < count; i++) {
+static region_t background_clip;
+
+ 
+ 
+ 
+ 
+static void compositor_cull(window_t **wins, int count) {
+  int noccluders = 0;
+  background_clip = paint_region;
+
+  for (int i = count - 1; i >= 0; i--) {
     window_t *w = wins[i];
+    region_clear(&w->clip);
     if (!w->visible)
       continue;
 
-     
-    int dest_x_start = w->x;
-    int dest_y_start = w->y;
-    int dest_x_end = w->x + w->width;
-    int dest_y_end = w->y + w->height;
-
-    int src_x = 0;
-    int src_y = 0;
+    rect_t bounds = rect_make(w->x, w->y, w->width, w->height);
+    region_intersect_rect(&w->clip, &paint_region, &bounds);
+    for (int j = 0; j < noccluders && !region_empty(&w->clip); j++)
+      region_subtract_rect(&w->clip, &occluders[j]);
 
      
-    if (dest_x_start < 0) {
-      src_x -= dest_x_start;
-      dest_x_start = 0;
+     
+    if (w->alpha != 255)
+      continue;
+    for (int j = 0; j < w->opaque.count && j < COMPOSITOR_OCCLUDER_RECTS;
+         j++) {
+      rect_t r = w->opaque.rects[j];
+      r.x0 += w->x;
+      r.x1 += w->x;
+      r.y0 += w->y;
+      r.y1 += w->y;
+      occluders[noccluders++] = r;
+      region_subtract_rect(&background_clip, &r);
     }
-    if (dest_y_start < 0) {
-      src_y -= dest_y_start;
-      dest_y_start = 0;
+  }
+}
+
+static uint64_t compose_background(const rect_t *tile) {
+  uint64_t painted = 0;
+  for (int i = 0; i < background_clip.count; i++) {
+    rect_t r;
+    if (!rect_intersect(&background_clip.rects[i], tile, &r))
+      continue;
+    for (int y = r.y0; y < r.y1; y++) {
+      uint32_t *row = &screen_backbuffer[y * screen_stride];
+      for (int x = r.x0; x < r.x1; x++)
+        row[x] = BG_COLOR;
     }
-    if (dest_x_end > screen_w)
-      dest_x_end = screen_w;
-    if (dest_y_end > screen_h)
-      dest_y_end = screen_h;
-
-    for (int y = dest_y_start; y < dest_y_end; y++) {
-      int row_idx = y * screen_w + dest_x_start;
-      int win_row_idx = (src_y + (y - dest_y_start)) * w->width + src_x;
-      for (int x = dest_x_start; x < dest_x_end; x++) {
-        uint32_t src_pixel = w->buffer[win_row_idx++];
-         
-         
-         
-         
-         
-
-        screen_backbuffer[row_idx] =
-            blend_colors(src_pixel, screen_backbuffer[row_idx], w->alpha);
-        row_idx++;
-      }
+    painted += rect_area(&r);
+  }
+  return painted;
+}
+
+static uint64_t compose_window(window_t *w, const rect_t *tile) {
+  uint64_t painted = 0;
+  for (int i = 0; i < w->clip.count; i++) {
+    rect_t r;
+    if (!rect_intersect(&w->clip.rects[i], tile, &r))
+      continue;
+    uint32_t n = (uint32_t)(r.x1 - r.x0);
+    for (int y = r.y0; y < r.y1; y++) {
+      uint32_t *dst = &screen_backbuffer[y * screen_stride + r.x0];
+      const uint32_t *src = &w->buffer[(y - w->y) * w->width + (r.x0 - w->x)];
+      blend_over_row(dst, src, n, w->alpha);
     }
+    painted += rect_area(&r);
   }
+  return painted;
+}
 
-   
-  int mx = cursor_x;
-  int my = cursor_y;
+ 
+ 
+static void compose_tile(void *info, uint32_t index) {
+  (void)info;
+  const rect_t *tile = &frame_tiles[index];
+  uint64_t painted = compose_background(tile);
+  for (int i = 0; i < frame_count; i++)
+    painted += compose_window(frame_windows[i], tile);
+  __atomic_fetch_add(&frame_painted, painted, __ATOMIC_RELAXED);
+}
 
-   
-  for (int i = 0; i < 12; i++) {
-    for (int j = 0; j < 12 - i; j++) {
-      int px = mx + j;
-      int py = my + i;
-      if (px >= 0 && px < screen_w && py >= 0 && py < screen_h) {
-         
-        if (j == 0 || i == 0 || j == 11 - i)
-          screen_backbuffer[py * screen_w + px] = 0x000000;
-        else
-          screen_backbuffer[py * screen_w + px] = 0xFFFFFF;
+static uint32_t compositor_build_tiles(void) {
+  if (region_empty(&paint_region))
+    return 0;
+
+  rect_t bounds = paint_region.rects[0];
+  for (int i = 1; i < paint_region.count; i++)
+    bounds = rect_union(&bounds, &paint_region.rects[i]);
+
+  uint32_t count = 0;
+  int ty0 = bounds.y0 - bounds.y0 % COMPOSITOR_TILE;
+  int tx0 = bounds.x0 - bounds.x0 % COMPOSITOR_TILE;
+  for (int y = ty0; y < bounds.y1; y += COMPOSITOR_TILE) {
+    for (int x = tx0; x < bounds.x1; x += COMPOSITOR_TILE) {
+      rect_t tile = rect_make(x, y, COMPOSITOR_TILE, COMPOSITOR_TILE);
+      for (int i = 0; i < paint_region.count; i++) {
+        if (rect_intersect(&tile, &paint_region.rects[i], NULL)) {
+          frame_tiles[count++] = tile;
+          break;
+        }
       }
     }
   }
+  return count;
+}
 
-   
-  extern void put_pixel(uint32_t x, uint32_t y,
-                        uint32_t color);  
+void compositor_set_cpus(uint32_t cpus) { compositor_cpus = cpus; }
 
-  for (int y = 0; y < screen_h; y++) {
-    for (int x = 0; x < screen_w; x++) {
-      put_pixel(x, y, screen_backbuffer[y * screen_w + x]);
-    }
+static void compositor_repaint_region(int age) {
+  rect_t screen = rect_make(0, 0, screen_w, screen_h);
+  if (age == 0 || age - 1 > history_count) {
+    region_init(&paint_region);
+    region_add(&paint_region, screen);
+    return;
   }
+
+  paint_region = screen_damage;
+  for (int i = 0; i < age - 1; i++) {
+    int slot = (history_head - i + DISPLAY_MAX_SURFACES - 1) %
+               (DISPLAY_MAX_SURFACES - 1);
+    region_add_region(&paint_region, &damage_history[slot], 0, 0);
+  }
+}
+
+static void compositor_push_history(void) {
+  history_head = (history_head + 1) % (DISPLAY_MAX_SURFACES - 1);
+  damage_history[history_head] = screen_damage;
+  if (history_count < DISPLAY_MAX_SURFACES - 1)
+    history_count++;
+}
+
+void compositor_render(int cursor_x, int cursor_y) {
+  if (!display_surface_count())
+    return;
+
+  window_t **wins = frame_windows;
+  int count = 0;
+  rcu_read_lock();
+  window_t *curr = rcu_dereference(window_list);
+  while (curr && count < frame_capacity) {
+    wins[count++] = curr;
+    compositor_track_window(curr);
+    curr = rcu_dereference(curr->next);
+  }
+
+  int cursor_dirty = display_cursor_move(cursor_x, cursor_y);
+
+  rect_t screen = rect_make(0, 0, screen_w, screen_h);
+  region_clip(&screen_damage, &screen);
+
+  stats.frames++;
+  frame_requested = 0;
+  if (region_empty(&screen_damage) && !cursor_dirty) {
+    rcu_read_unlock();
+    stats.idle_frames++;
+    stats.last_damaged_pixels = 0;
+    stats.last_painted_pixels = 0;
+    return;
+  }
+
+   
+   
+  int age;
+  screen_backbuffer = display_acquire(&age);
+  compositor_repaint_region(age);
+
+  compositor_cull(wins, count);
+  frame_count = count;
+  frame_painted = 0;
+  uint32_t tiles = compositor_build_tiles();
+  uint32_t cpus = compositor_cpus;
+  if (region_area(&paint_region) < COMPOSITOR_PARALLEL_MIN)
+    cpus = 1;
+  smp_parallel_for(compose_tile, NULL, tiles, cpus);
+  uint64_t painted = frame_painted;
+  rcu_read_unlock();
+
+  display_present(&paint_region);
+  compositor_push_history();
+
+  stats.last_damaged_pixels = region_area(&paint_region);
+  stats.damaged_pixels += stats.last_damaged_pixels;
+  stats.last_painted_pixels = painted;
+  stats.painted_pixels += painted;
+  region_clear(&screen_damage);
 }
 
 void compositor_raise_window(window_t *win) {
-  if (!win)
+  if (!win || window_unlink(win) < 0)
     return;
 
   int max_z = win->z_index;
-  window_t *curr = window_list;
-  while (curr) {
+  for (window_t *curr = window_list; curr; curr = curr->next) {
     if (curr->z_index > max_z)
       max_z = curr->z_index;
-    curr = curr->next;
   }
   win->z_index = max_z + 1;
+  window_link(win);
+  compositor_request_frame();
+}
+
+ 
+
+void window_damage(window_t *win, int x, int y, int w, int h) {
+  if (!win)
+    return;
+  rect_t r = rect_make(x, y, w, h);
+  rect_t bounds = rect_make(0, 0, win->width, win->height);
+  if (rect_intersect(&r, &bounds, &r)) {
+    region_add(&win->damage, r);
+    compositor_request_frame();
+  }
+}
+
+ 
+ 
+ 
+static uint8_t corner_coverage(int radius, int i, int j) {
+  int r8 = radius * 8;
+  uint32_t inside = 0;
+  for (int sy = 0; sy < 4; sy++) {
+    for (int sx = 0; sx < 4; sx++) {
+      int dx = r8 - (j * 8 + sx * 2 + 1);
+      int dy = r8 - (i * 8 + sy * 2 + 1);
+      if (dx <= 0 || dy <= 0 || dx * dx + dy * dy <= r8 * r8)
+        inside++;
+    }
+  }
+  return (uint8_t)(inside * 255 / 16);
+}
+
+ 
+ 
+static inline uint8_t window_shape_coverage(const window_t *win, int x,
+                                            int y) {
+  int r = win->corner_radius;
+  int i = y < r ? y : win->height - 1 - y;
+  int j = x < r ? x : win->width - 1 - x;
+  if (i >= r || j >= r)
+    return 255;
+  return win->corner_mask[i * r + j];
+}
+
+static inline uint32_t window_shape_pixel(const window_t *win, int x, int y,
+                                          uint32_t color) {
+  uint8_t cov = window_shape_coverage(win, x, y);
+  return cov == 255 ? color : blend_scale_pixel(color, cov);
 }
 
+static int window_shape_rects(const window_t *win, rect_t parts[3]) {
+  int r = win->corner_radius;
+  int w = win->width;
+  int h = win->height;
+
+  if (!r) {
+    parts[0] = rect_make(0, 0, w, h);
+    return 1;
+  }
+  if (r * 2 > w || r * 2 > h)
+    return 0;
+  parts[0] = rect_make(r, 0, w - r * 2, h);
+  parts[1] = rect_make(0, r, r, h - r * 2);
+  parts[2] = rect_make(w - r, r, r, h - r * 2);
+  return 3;
+}
+
+ 
+ 
  
+static void window_opaque_remove(window_t *win, const rect_t *cut) {
+  if (region_subtract_rect(&win->opaque, cut) == 0)
+    return;
+  for (int i = 0; i < win->opaque.count;) {
+    rect_t x;
+    if (rect_intersect(&win->opaque.rects[i], cut, &x))
+      win->opaque.rects[i] = win->opaque.rects[--win->opaque.count];
+    else
+      i++;
+  }
+}
+
+ 
+ 
+ 
+static void window_opaque_add(window_t *win, const rect_t *r) {
+  rect_t parts[3];
+  int n = window_shape_rects(win, parts);
+  for (int i = 0; i < n; i++) {
+    rect_t piece;
+    if (!rect_intersect(r, &parts[i], &piece))
+      continue;
+
+    int64_t expect = region_area(&win->opaque) + rect_area(&piece);
+    for (int j = 0; j < win->opaque.count; j++) {
+      rect_t x;
+      if (rect_intersect(&win->opaque.rects[j], &piece, &x))
+        expect -= rect_area(&x);
+    }
+    region_add(&win->opaque, piece);
+    if (region_area(&win->opaque) != expect) {
+      region_clear(&win->opaque);
+      return;
+    }
+  }
+}
+
+static void window_corner_rects(const window_t *win, int r, rect_t sq[4]) {
+  sq[0] = rect_make(0, 0, r, r);
+  sq[1] = rect_make(win->width - r, 0, r, r);
+  sq[2] = rect_make(0, win->height - r, r, r);
+  sq[3] = rect_make(win->width - r, win->height - r, r, r);
+}
+
+ 
+ 
+static void window_mask_corners(window_t *win) {
+  int r = win->corner_radius;
+  int w = win->width;
+  int h = win->height;
+  rect_t parts[3];
+  if (!r || !window_shape_rects(win, parts))
+    return;
+
+  for (int i = 0; i < r; i++) {
+    for (int j = 0; j < r; j++) {
+      uint8_t cov = win->corner_mask[i * r + j];
+      if (cov == 255)
+        continue;
+      int xs[2] = {j, w - 1 - j};
+      int ys[2] = {i, h - 1 - i};
+      for (int c = 0; c < 4; c++) {
+        uint32_t *p = &win->buffer[ys[c >> 1] * w + xs[c & 1]];
+        *p = blend_scale_pixel(*p, cov);
+      }
+    }
+  }
+  window_damage(win, 0, 0, r, r);
+  window_damage(win, w - r, 0, r, r);
+  window_damage(win, 0, h - r, r, r);
+  window_damage(win, w - r, h - r, r, r);
+}
+
+ 
+ 
+static void window_apply_shape(window_t *win) {
+  rect_t parts[3];
+  int n = window_shape_rects(win, parts);
+  region_clear(&win->opaque);
+  for (int i = 0; i < n; i++)
+    region_add(&win->opaque, parts[i]);
+  window_mask_corners(win);
+}
 
 void window_clear(window_t *win, uint32_t color) {
   if (!win || !win->buffer)
     return;
-  for (int i = 0; i < win->width * win->height; i++) {
-    win->buffer[i] = color;
-  }
+  window_fill_rect(win, 0, 0, win->width, win->height, color);
 }
 
 void window_fill_rect(window_t *win, int x, int y, int w, int h,
                       uint32_t color) {
+  window_fill_rect_argb(win, x, y, w, h, color | ARGB_OPAQUE);
+}
+
+ 
+ 
+void window_fill_rect_argb(window_t *win, int x, int y, int w, int h,
+                           uint32_t color) {
   if (!win)
     return;
-  for (int py = y; py < y + h; py++) {
-    if (py < 0 || py >= win->height)
+
+  rect_t r = rect_make(x, y, w, h);
+  rect_t bounds = rect_make(0, 0, win->width, win->height);
+  if (!rect_intersect(&r, &bounds, &r))
+    return;
+
+  int radius = win->corner_radius;
+  rect_t changed = {r.x1, r.y1, r.x0, r.y0};
+  for (int py = r.y0; py < r.y1; py++) {
+    uint32_t *row = &win->buffer[py * win->width];
+    int shaped = radius && (py < radius || py >= win->height - radius);
+    int first = -1, last = -1;
+    for (int px = r.x0; px < r.x1; px++) {
+      uint32_t c = shaped ? window_shape_pixel(win, px, py, color) : color;
+      if (row[px] == c)
+        continue;
+      row[px] = c;
+      if (first < 0)
+        first = px;
+      last = px;
+    }
+    if (first < 0)
       continue;
-    for (int px = x; px < x + w; px++) {
-      if (px < 0 || px >= win->width)
+    if (first < changed.x0)
+      changed.x0 = first;
+    if (last + 1 > changed.x1)
+      changed.x1 = last + 1;
+    if (py < changed.y0)
+      changed.y0 = py;
+    changed.y1 = py + 1;
+  }
+
+  if ((color >> 24) == 255)
+    window_opaque_add(win, &r);
+  else
+    window_opaque_remove(win, &r);
+
+  if (!rect_empty(&changed)) {
+    region_add(&win->damage, changed);
+    compositor_request_frame();
+  }
+}
+
+ 
+ 
+ 
+void window_blit(window_t *win, int x, int y, int w, int h,
+                 const uint32_t *src) {
+  if (!win || !src)
+    return;
+
+  rect_t r = rect_make(x, y, w, h);
+  rect_t bounds = rect_make(0, 0, win->width, win->height);
+  if (!rect_intersect(&r, &bounds, &r))
+    return;
+
+  rect_t changed = {r.x1, r.y1, r.x0, r.y0};
+  rect_t translucent = {r.x1, r.y1, r.x0, r.y0};
+  for (int py = r.y0; py < r.y1; py++) {
+    uint32_t *row = &win->buffer[py * win->width];
+    const uint32_t *from = &src[(py - y) * w + (r.x0 - x)];
+    int first = -1, last = -1;
+    for (int px = r.x0; px < r.x1; px++) {
+      uint32_t c = from[px - r.x0];
+      if ((c >> 24) != 255 && window_shape_coverage(win, px, py) == 255) {
+        if (px < translucent.x0)
+          translucent.x0 = px;
+        if (px + 1 > translucent.x1)
+          translucent.x1 = px + 1;
+        if (py < translucent.y0)
+          translucent.y0 = py;
+        translucent.y1 = py + 1;
+      }
+      if (row[px] == c)
         continue;
-      win->buffer[py * win->width + px] = color;
+      row[px] = c;
+      if (first < 0)
+        first = px;
+      last = px;
     }
+    if (first < 0)
+      continue;
+    if (first < changed.x0)
+      changed.x0 = first;
+    if (last + 1 > changed.x1)
+      changed.x1 = last + 1;
+    if (py < changed.y0)
+      changed.y0 = py;
+    changed.y1 = py + 1;
   }
+
+  if (!rect_empty(&translucent))
+    window_opaque_remove(win, &translucent);
+
+  if (!rect_empty(&changed)) {
+    region_add(&win->damage, changed);
+    compositor_request_frame();
+  }
+}
+
+void window_read(const window_t *win, int x, int y, int w, int h,
+                 uint32_t *dst) {
+  if (!win || !dst || x < 0 || y < 0 || x + w > win->width ||
+      y + h > win->height)
+    return;
+  for (int py = 0; py < h; py++)
+    k_memcpy(&dst[py * w], &win->buffer[(y + py) * win->width + x], w * 4);
 }
 
 void window_draw_rect(window_t *win, int x, int y, int w, int h, uint32_t color,
@@ -278,34 +937,103 @@ void window_draw_rect(window_t *win, int x, int y, int w, int h, uint32_t color,
   window_fill_rect(win, x + w - thickness, y, thickness, h, color);
 }
 
-void window_draw_text(window_t *win, int x, int y, const char *text,
-                      uint32_t color) {
-  if (!win || !text)
-    return;
-  int ox = x;
-  while (*text) {
-    if (*text == '\n') {
-      x = ox;
-      y += 16;
-      text++;
+static int text_blit_glyph(window_t *win, int gx, int y, int row0, int row1,
+                           int index, uint64_t pair) {
+  const uint8_t *bits = glyph_bitmap(index);
+  const uint32_t *mask = glyph_mask(index);
+  int changed = 0;
+  for (int row = row0; row < row1; row++) {
+    if (!bits[row])
       continue;
+    uint32_t *dst = &win->buffer[(y + row) * win->width + gx];
+    const uint32_t *m = &mask[row * GLYPH_WIDTH];
+    for (int col = 0; col < GLYPH_WIDTH; col += 2) {
+      uint64_t d, mm;
+      __builtin_memcpy(&d, dst + col, 8);
+      __builtin_memcpy(&mm, m + col, 8);
+      uint64_t n = (d & ~mm) | (pair & mm);
+      if (n != d) {
+        __builtin_memcpy(dst + col, &n, 8);
+        changed = 1;
+      }
     }
-    if (*text >= 32 && *text < 127) {
-      const uint8_t *glyph = font_8x16[*text - 32];
-      for (int row = 0; row < 16; row++) {
-        if (y + row < 0 || y + row >= win->height)
-          continue;
-        uint8_t bits = glyph[row];
-        for (int col = 0; col < 8; col++) {
-          if (x + col < 0 || x + col >= win->width)
-            continue;
-          if (bits & (0x80 >> col))
-            win->buffer[(y + row) * win->width + (x + col)] = color;
-        }
+  }
+  return changed;
+}
+
+static int text_blit_clipped(window_t *win, int gx, int y, int row0, int row1,
+                             int index, uint32_t color) {
+  const uint8_t *bits = glyph_bitmap(index);
+  int col0 = gx < 0 ? -gx : 0;
+  int col1 = gx + GLYPH_WIDTH > win->width ? win->width - gx : GLYPH_WIDTH;
+  int changed = 0;
+  for (int row = row0; row < row1; row++) {
+    uint32_t *dst = &win->buffer[(y + row) * win->width + gx];
+    for (int col = col0; col < col1; col++) {
+      if ((bits[row] & (0x80 >> col)) && dst[col] != color) {
+        dst[col] = color;
+        changed = 1;
       }
     }
-    x += 8;
-    text++;
+  }
+  return changed;
+}
+
+ 
+ 
+ 
+ 
+static void window_draw_text_line(window_t *win, int x, int y, const char *text,
+                                  int len, uint32_t color) {
+  int row0 = y < 0 ? -y : 0;
+  int row1 = y + GLYPH_HEIGHT > win->height ? win->height - y : GLYPH_HEIGHT;
+  if (row0 >= row1)
+    return;
+
+  int start = x < 0 ? -x / GLYPH_WIDTH : 0;
+  int end = (win->width - x + GLYPH_WIDTH - 1) / GLYPH_WIDTH;
+  if (end > len)
+    end = len;
+  int full0 = x < 0 ? (-x + GLYPH_WIDTH - 1) / GLYPH_WIDTH : 0;
+  int full1 = (win->width - x) / GLYPH_WIDTH;
+
+  uint64_t pair = ((uint64_t)color << 32) | color;
+  int dirty0 = len, dirty1 = -1;
+  for (int i = start; i < end; i++) {
+    char c = text[i];
+    if (c < 32 || c >= 127)
+      continue;
+    int index = glyph_index(c);
+    int gx = x + i * GLYPH_WIDTH;
+    int changed = i >= full0 && i < full1
+                      ? text_blit_glyph(win, gx, y, row0, row1, index, pair)
+                      : text_blit_clipped(win, gx, y, row0, row1, index, color);
+    if (changed) {
+      if (i < dirty0)
+        dirty0 = i;
+      dirty1 = i;
+    }
+  }
+
+  if (dirty1 >= 0)
+    window_damage(win, x + dirty0 * GLYPH_WIDTH, y,
+                  (dirty1 - dirty0 + 1) * GLYPH_WIDTH, GLYPH_HEIGHT);
+}
+
+void window_draw_text(window_t *win, int x, int y, const char *text,
+                      uint32_t color) {
+  if (!win || !text || !win->buffer)
+    return;
+  color |= ARGB_OPAQUE;
+  while (*text) {
+    const char *end = text;
+    while (*end && *end != '\n')
+      end++;
+    window_draw_text_line(win, x, y, text, (int)(end - text), color);
+    if (!*end)
+      break;
+    y += GLYPH_HEIGHT;
+    text = end + 1;
   }
 }
 
@@ -313,6 +1041,7 @@ void window_move(window_t *win, int dx, int dy) {
   if (win) {
     win->x += dx;
     win->y += dy;
+    compositor_request_frame();
   }
 }
 
@@ -324,12 +1053,82 @@ void window_resize(window_t *win, int w, int h) {
   uint32_t *new_buf = (uint32_t *)malloc(w * h * 4);
   if (!new_buf)
     return;
-  k_memset(new_buf, 0, w * h * 4);
+  for (int i = 0; i < w * h; i++)
+    new_buf[i] = ARGB_OPAQUE;
   if (win->buffer)
     free(win->buffer);
   win->buffer = new_buf;
   win->width = w;
   win->height = h;
+  region_clear(&win->damage);
+  window_apply_shape(win);
+  compositor_request_frame();
+}
+
+void window_set_corner_radius(window_t *win, int radius) {
+  if (!win || !win->buffer)
+    return;
+  if (radius < 0)
+    radius = 0;
+  if (radius > WINDOW_MAX_RADIUS)
+    radius = WINDOW_MAX_RADIUS;
+  if (radius == win->corner_radius)
+    return;
+
+  int old = win->corner_radius;
+  win->corner_radius = radius;
+  for (int i = 0; i < radius; i++) {
+    for (int j = 0; j < radius; j++)
+      win->corner_mask[i * radius + j] = corner_coverage(radius, i, j);
+  }
+
+   
+   
+   
+   
+  rect_t sq[4];
+  if (old && old * 2 <= win->width && old * 2 <= win->height) {
+    window_corner_rects(win, old, sq);
+    for (int c = 0; c < 4; c++) {
+      for (int y = sq[c].y0; y < sq[c].y1; y++)
+        for (int x = sq[c].x0; x < sq[c].x1; x++)
+          win->buffer[y * win->width + x] = ARGB_OPAQUE;
+      window_damage(win, sq[c].x0, sq[c].y0, old, old);
+    }
+  }
+  window_mask_corners(win);
+
+  int span = old > radius ? old : radius;
+  if (span * 2 > win->width || span * 2 > win->height) {
+    region_clear(&win->opaque);
+    return;
+  }
+  window_corner_rects(win, span, sq);
+  for (int c = 0; c < 4; c++) {
+    window_opaque_remove(win, &sq[c]);
+    window_opaque_add(win, &sq[c]);
+  }
+}
+
+void window_draw_shadow(window_t *win, int spread, uint8_t alpha) {
+  if (!win || !win->buffer || spread <= 0)
+    return;
+
+  int w = win->width;
+  int h = win->height;
+  for (int y = 0; y < h; y++) {
+    int dy = y < h - 1 - y ? y : h - 1 - y;
+    uint32_t *row = &win->buffer[y * w];
+    for (int x = 0; x < w; x++) {
+      int dx = x < w - 1 - x ? x : w - 1 - x;
+      uint32_t fy = dy < spread ? (uint32_t)(dy + 1) : (uint32_t)spread + 1;
+      uint32_t fx = dx < spread ? (uint32_t)(dx + 1) : (uint32_t)spread + 1;
+      uint32_t a = alpha * fx * fy / (uint32_t)((spread + 1) * (spread + 1));
+      row[x] = a << 24;
+    }
+  }
+  window_damage(win, 0, 0, w, h);
+  region_clear(&win->opaque);
 }
 
 int compositor_get_width(void) { return screen_w; }
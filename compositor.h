@@ -1,9 +1,14 @@
 #ifndef COMPOSITOR_H
 #define COMPOSITOR_H
 
+#include "rcu.h"
+#include "region.h"
 #include <stddef.h>
 #include <stdint.h>
 
+#define ARGB_OPAQUE 0xFF000000u
+#define WINDOW_MAX_RADIUS 16
+
  
 typedef struct window {
   int id;
@@ -14,10 +19,70 @@ typedef struct window {
   int visible;
   uint8_t alpha;  
   struct window *next;
+  struct rcu_head rcu;
+
+   
+  region_t damage;
+
+  /* Pixels known to have alpha 255; the compositor culls beneath it, so it
+     must never cover a translucent pixel. Fills keep it up to date. */
+  region_t opaque;
+  int corner_radius;
+  uint8_t corner_mask[WINDOW_MAX_RADIUS * WINDOW_MAX_RADIUS];
+
+   
+   
+  region_t clip;
+
+   
+   
+  struct {
+    int x, y;
+    int width, height;
+    int z_index;
+    int visible;
+    uint8_t alpha;
+  } shown;
 } window_t;
 
+#define COMPOSITOR_DEFAULT_HZ 60
+#define COMPOSITOR_FRAME_BUCKETS 8
+
+struct compositor_stats {
+  uint64_t frames;
+  uint64_t idle_frames;
+  uint64_t damaged_pixels;
+  uint64_t last_damaged_pixels;
+  uint64_t painted_pixels;
+  uint64_t last_painted_pixels;
+
+   
+   
+  uint64_t ticks;
+  uint64_t invalidations;
+  uint64_t timed_frames;
+  uint64_t frame_ticks;
+  uint64_t last_frame_ticks;
+  uint64_t max_frame_ticks;
+  uint64_t missed_frames;
+  uint32_t frame_hist[COMPOSITOR_FRAME_BUCKETS];
+};
+
  
 void compositor_init(void);
+void compositor_shutdown(void);
+
+ 
+ 
+ 
+void compositor_start(void);
+void compositor_set_refresh(uint32_t hz);
+uint32_t compositor_get_refresh(void);
+
+ 
+ 
+void compositor_commit(int cursor_x, int cursor_y);
+void compositor_wait_frame(void);
 
  
 window_t *compositor_create_window(int x, int y, int w, int h, int z_index);
@@ -30,15 +95,45 @@ void compositor_render(int cursor_x, int cursor_y);
 void compositor_raise_window(window_t *win);
 
  
+void compositor_damage(int x, int y, int w, int h);
+void compositor_get_stats(struct compositor_stats *stats);
+void compositor_print_stats(void);
+
+ 
+void compositor_set_cpus(uint32_t cpus);
+
+ 
 void window_clear(window_t *win, uint32_t color);
 void window_fill_rect(window_t *win, int x, int y, int w, int h,
                       uint32_t color);
+void window_fill_rect_argb(window_t *win, int x, int y, int w, int h,
+                           uint32_t color);
+
+ 
+ 
+ 
+void window_blit(window_t *win, int x, int y, int w, int h,
+                 const uint32_t *src);
+void window_read(const window_t *win, int x, int y, int w, int h,
+                 uint32_t *dst);
 void window_draw_rect(window_t *win, int x, int y, int w, int h, uint32_t color,
                       int thickness);
 void window_draw_text(window_t *win, int x, int y, const char *text,
                       uint32_t color);
 
  
+ 
+ 
+ 
+/* Changing the radius of an already shaped window resets the old corner
+   squares to opaque black; redraw them afterwards. */
+void window_set_corner_radius(window_t *win, int radius);
+void window_draw_shadow(window_t *win, int spread, uint8_t alpha);
+
+ 
+void window_damage(window_t *win, int x, int y, int w, int h);
+
+ 
 void window_move(window_t *win, int dx, int dy);
 void window_resize(window_t *win, int w, int h);
 
@@ -1,4 +1,5 @@
 #include "console.h"
+#include "glyph.h"
 
 const uint8_t font_8x16[95][16] = {
 
@@ -288,33 +289,6 @@ const uint8_t font_8x16[95][16] = {
      0x00, 0x00, 0x00, 0x00},
 };
 
-static const uint8_t custom_glyphs[8][16] = {
-    {0},
-
-    {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-     0xFF, 0xFF, 0xFF, 0xFF},
-
-    {0x36, 0x36, 0x36, 0x36, 0x36, 0x36, 0x36, 0x36, 0x36, 0x36, 0x36, 0x36,
-     0x36, 0x36, 0x36, 0x36},
-
-    {0x00, 0x00, 0x00, 0x3E, 0x36, 0x36, 0x36, 0x36, 0x36, 0x36, 0x36, 0x36,
-     0x36, 0x36, 0x36, 0x36},
-
-    {0x00, 0x00, 0x00, 0x00, 0x00, 0x63, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33,
-     0x33, 0x33, 0x33, 0x33},
-
-    {0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x63, 0x00, 0x00,
-     0x00, 0x00, 0x00, 0x00},
-
-    {0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x3F, 0x00, 0x00,
-     0x00, 0x00, 0x00, 0x00},
-
-    {0x00, 0x00, 0x00, 0x00, 0x00, 0x3F, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33,
-     0x33, 0x33, 0x33, 0x33},
-
-    {0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x00, 0x00, 0xFF, 0x00, 0x00, 0x00,
-     0x00, 0x00, 0x00, 0x00}};
-
 static uint32_t cursor_x = 0;
 static uint32_t cursor_y = 0;
 static uint32_t console_width = 0;
@@ -326,6 +300,40 @@ static uint32_t current_fg_color = 0xFFFFFF;
 #define CHAR_HEIGHT 16
 #define BG_COLOR 0x000000
 
+#define CONSOLE_MAX_COLS 256
+#define CONSOLE_HISTORY 1024
+#define CONSOLE_PALETTE 32
+#define CONSOLE_MAX_ROWS (CONSOLE_HISTORY / 4)
+
+ 
+ 
+ 
+ 
+struct console_cell {
+  uint8_t ch;
+  uint8_t color;
+};
+
+static struct console_cell console_cells[CONSOLE_HISTORY][CONSOLE_MAX_COLS];
+static uint32_t ring_top = 0;
+static uint32_t history_rows = 0;
+static uint32_t view_offset = 0;
+
+ 
+ 
+ 
+ 
+ 
+static struct console_cell shown[CONSOLE_MAX_ROWS][CONSOLE_MAX_COLS];
+static uint16_t dirty_lo[CONSOLE_HISTORY];
+static uint16_t dirty_hi[CONSOLE_HISTORY];
+static uint32_t pending_scroll = 0;
+static int view_changed = 0;
+
+static uint32_t palette[CONSOLE_PALETTE] = {0xFFFFFF};
+static uint32_t palette_count = 1;
+static uint8_t current_fg_index = 0;
+
 void put_pixel(uint32_t x, uint32_t y, uint32_t color) {
   if (fb == NULL || x >= fb->width || y >= fb->height)
     return;
@@ -334,24 +342,260 @@ void put_pixel(uint32_t x, uint32_t y, uint32_t color) {
   *pixel = color;
 }
 
+static inline void fb_copy_row(uint32_t *dst, const uint32_t *src,
+                               uint32_t n) {
+  if (((uintptr_t)dst & 7) && n) {
+    *dst++ = *src++;
+    n--;
+  }
+
+  uint64_t *d = (uint64_t *)dst;
+  while (n >= 8) {
+    uint64_t a, b, c, e;
+    __builtin_memcpy(&a, src, 8);
+    __builtin_memcpy(&b, src + 2, 8);
+    __builtin_memcpy(&c, src + 4, 8);
+    __builtin_memcpy(&e, src + 6, 8);
+    d[0] = a;
+    d[1] = b;
+    d[2] = c;
+    d[3] = e;
+    d += 4;
+    src += 8;
+    n -= 8;
+  }
+
+  dst = (uint32_t *)d;
+  while (n--)
+    *dst++ = *src++;
+}
+
+static inline void fb_fill_row(uint32_t *dst, uint32_t color, uint32_t n) {
+  if (((uintptr_t)dst & 7) && n) {
+    *dst++ = color;
+    n--;
+  }
+
+  uint64_t pair = ((uint64_t)color << 32) | color;
+  uint64_t *d = (uint64_t *)dst;
+  while (n >= 8) {
+    d[0] = pair;
+    d[1] = pair;
+    d[2] = pair;
+    d[3] = pair;
+    d += 4;
+    n -= 8;
+  }
+
+  dst = (uint32_t *)d;
+  while (n--)
+    *dst++ = color;
+}
+
+ 
+ 
+static int fb_clip(int *x, int *y, int *w, int *h, int *dx, int *dy) {
+  if (fb == NULL)
+    return 0;
+  *dx = 0;
+  *dy = 0;
+  if (*x < 0) {
+    *dx = -*x;
+    *w += *x;
+    *x = 0;
+  }
+  if (*y < 0) {
+    *dy = -*y;
+    *h += *y;
+    *y = 0;
+  }
+  if (*x + *w > (int)fb->width)
+    *w = (int)fb->width - *x;
+  if (*y + *h > (int)fb->height)
+    *h = (int)fb->height - *y;
+  return *w > 0 && *h > 0;
+}
+
+void fb_blit_rect(int x, int y, int w, int h, const uint32_t *src,
+                  int src_stride) {
+  int dx, dy;
+  if (!fb_clip(&x, &y, &w, &h, &dx, &dy))
+    return;
+
+  src += (int64_t)dy * src_stride + dx;
+  uint8_t *dst = (uint8_t *)fb->address + (uint64_t)y * fb->pitch + x * 4;
+  for (int row = 0; row < h; row++) {
+    fb_copy_row((uint32_t *)dst, src, (uint32_t)w);
+    dst += fb->pitch;
+    src += src_stride;
+  }
+}
+
+void fb_fill_rect(int x, int y, int w, int h, uint32_t color) {
+  int dx, dy;
+  if (!fb_clip(&x, &y, &w, &h, &dx, &dy))
+    return;
+
+  uint8_t *dst = (uint8_t *)fb->address + (uint64_t)y * fb->pitch + x * 4;
+  for (int row = 0; row < h; row++) {
+    fb_fill_row((uint32_t *)dst, color, (uint32_t)w);
+    dst += fb->pitch;
+  }
+}
+
 static void draw_char(uint32_t x, uint32_t y, char c, uint32_t fg_color,
                       uint32_t bg_color) {
-  const uint8_t *glyph;
-  if (c >= 1 && c <= 7) {
-    glyph = custom_glyphs[(int)c];
-  } else if (c < 32 || c > 126) {
-    c = ' ';
-    glyph = font_8x16[0];
-  } else {
-    glyph = font_8x16[c - 32];
-  }
+  if (x + CHAR_WIDTH > fb->width || y + CHAR_HEIGHT > fb->height)
+    return;
 
+  const struct glyph_atlas *atlas = glyph_atlas_get(fg_color, bg_color);
+  const uint32_t *src = atlas->rows[glyph_index(c)][0];
+  uint8_t *dst = (uint8_t *)fb->address + (uint64_t)y * fb->pitch + x * 4;
   for (int row = 0; row < CHAR_HEIGHT; row++) {
-    uint8_t bits = glyph[row];
-    for (int col = 0; col < CHAR_WIDTH; col++) {
-      uint32_t color = (bits & (0x80 >> col)) ? fg_color : bg_color;
-      put_pixel(x + col, y + row, color);
+    glyph_store_row((uint32_t *)dst, src);
+    dst += fb->pitch;
+    src += CHAR_WIDTH;
+  }
+}
+
+static void console_set_fg(uint32_t color) {
+  current_fg_color = color;
+  for (uint32_t i = 0; i < palette_count; i++) {
+    if (palette[i] == color) {
+      current_fg_index = (uint8_t)i;
+      return;
+    }
+  }
+  if (palette_count < CONSOLE_PALETTE) {
+    palette[palette_count] = color;
+    current_fg_index = (uint8_t)palette_count++;
+  }
+}
+
+static inline uint32_t console_ring(uint32_t row) {
+  return (ring_top + row) % CONSOLE_HISTORY;
+}
+
+static inline struct console_cell *console_row(uint32_t row) {
+  return console_cells[console_ring(row)];
+}
+
+static void console_clear_row(struct console_cell *row) {
+  for (uint32_t x = 0; x < console_width; x++) {
+    row[x].ch = ' ';
+    row[x].color = 0;
+  }
+}
+
+static inline void console_mark(uint32_t ring, uint32_t x) {
+  if (dirty_lo[ring] >= dirty_hi[ring]) {
+    dirty_lo[ring] = (uint16_t)x;
+    dirty_hi[ring] = (uint16_t)(x + 1);
+  } else if (x < dirty_lo[ring]) {
+    dirty_lo[ring] = (uint16_t)x;
+  } else if (x >= dirty_hi[ring]) {
+    dirty_hi[ring] = (uint16_t)(x + 1);
+  }
+}
+
+static inline void console_set_cell(uint32_t x, uint32_t y, uint8_t ch,
+                                    uint8_t color) {
+  uint32_t ring = console_ring(y);
+  console_cells[ring][x].ch = ch;
+  console_cells[ring][x].color = color;
+  console_mark(ring, x);
+}
+
+ 
+ 
+static void console_scroll(void) {
+  ring_top = (ring_top + 1) % CONSOLE_HISTORY;
+  if (history_rows < CONSOLE_HISTORY - console_height)
+    history_rows++;
+
+  uint32_t ring = console_ring(console_height - 1);
+  console_clear_row(console_cells[ring]);
+  dirty_lo[ring] = 0;
+  dirty_hi[ring] = 0;
+  if (pending_scroll < console_height)
+    pending_scroll++;
+}
+
+static void console_blank_shown(uint32_t from, uint32_t to) {
+  for (uint32_t y = from; y < to; y++)
+    for (uint32_t x = 0; x < console_width; x++) {
+      shown[y][x].ch = ' ';
+      shown[y][x].color = 0;
     }
+}
+
+ 
+ 
+ 
+static void console_shift(uint32_t lines) {
+  uint32_t keep = console_height - lines;
+  uint8_t *base = (uint8_t *)fb->address;
+
+  if (keep) {
+    uint64_t bytes = (uint64_t)keep * CHAR_HEIGHT * fb->pitch;
+    fb_copy_row((uint32_t *)base,
+                (const uint32_t *)(base + lines * CHAR_HEIGHT * fb->pitch),
+                (uint32_t)(bytes / 4));
+    fb_copy_row((uint32_t *)shown[0], (const uint32_t *)shown[lines],
+                keep * CONSOLE_MAX_COLS / 2);
+  }
+  fb_fill_rect(0, keep * CHAR_HEIGHT, fb->width,
+               fb->height - keep * CHAR_HEIGHT, BG_COLOR);
+  console_blank_shown(keep, console_height);
+}
+
+ 
+ 
+static void console_flush_row(uint32_t y, uint32_t ring, uint32_t lo,
+                              uint32_t hi) {
+  const struct console_cell *row = console_cells[ring];
+  struct console_cell *seen = shown[y];
+  for (uint32_t x = lo; x < hi; x++) {
+    if (seen[x].ch == row[x].ch && seen[x].color == row[x].color)
+      continue;
+    seen[x] = row[x];
+    draw_char(x * CHAR_WIDTH, y * CHAR_HEIGHT, (char)row[x].ch,
+              palette[row[x].color], BG_COLOR);
+  }
+}
+
+ 
+ 
+ 
+ 
+static void console_flush(void) {
+  if (fb == NULL)
+    return;
+
+  if (view_changed) {
+    for (uint32_t y = 0; y < console_height; y++) {
+      uint32_t ring =
+          (ring_top + CONSOLE_HISTORY + y - view_offset) % CONSOLE_HISTORY;
+      console_flush_row(y, ring, 0, console_width);
+      if (view_offset == 0)
+        dirty_lo[ring] = dirty_hi[ring] = 0;
+    }
+    view_changed = 0;
+    pending_scroll = 0;
+    return;
+  }
+
+  if (pending_scroll) {
+    console_shift(pending_scroll);
+    pending_scroll = 0;
+  }
+
+  for (uint32_t y = 0; y < console_height; y++) {
+    uint32_t ring = console_ring(y);
+    if (dirty_lo[ring] >= dirty_hi[ring])
+      continue;
+    console_flush_row(y, ring, dirty_lo[ring], dirty_hi[ring]);
+    dirty_lo[ring] = dirty_hi[ring] = 0;
   }
 }
 
@@ -360,14 +604,46 @@ void console_init(struct limine_framebuffer *framebuffer) {
   cursor_x = 0;
   cursor_y = 0;
   console_width = fb->width / CHAR_WIDTH;
+  if (console_width > CONSOLE_MAX_COLS)
+    console_width = CONSOLE_MAX_COLS;
   console_height = fb->height / CHAR_HEIGHT;
-  current_fg_color = 0xFFFFFF;
+  if (console_height > CONSOLE_MAX_ROWS)
+    console_height = CONSOLE_MAX_ROWS;
+  ring_top = 0;
+  history_rows = 0;
+  view_offset = 0;
+  pending_scroll = 0;
+  view_changed = 0;
+  console_set_fg(0xFFFFFF);
   console_clear();
 }
 
-void console_putchar(char c) {
+void console_scroll_view(int lines) {
   if (fb == NULL)
     return;
+  int64_t offset = (int64_t)view_offset + lines;
+  if (offset < 0)
+    offset = 0;
+  if (offset > (int64_t)history_rows)
+    offset = history_rows;
+  if ((uint32_t)offset == view_offset)
+    return;
+  view_offset = (uint32_t)offset;
+  view_changed = 1;
+  console_flush();
+}
+
+uint32_t console_get_scrollback(void) { return view_offset; }
+
+static inline void console_go_live(void) {
+  if (view_offset) {
+    view_offset = 0;
+    view_changed = 1;
+  }
+}
+
+static void console_emit(char c) {
+  console_go_live();
 
   if (c == '\n') {
     cursor_x = 0;
@@ -377,8 +653,7 @@ void console_putchar(char c) {
   } else if (c == '\b') {
     console_backspace();
   } else {
-    draw_char(cursor_x * CHAR_WIDTH, cursor_y * CHAR_HEIGHT, c,
-              current_fg_color, BG_COLOR);
+    console_set_cell(cursor_x, cursor_y, (uint8_t)c, current_fg_index);
     cursor_x++;
   }
 
@@ -388,27 +663,18 @@ void console_putchar(char c) {
   }
 
   if (cursor_y >= console_height) {
-
-    uint32_t *buffer = (uint32_t *)fb->address;
-    uint64_t pitch_pixels = fb->pitch / 4;
-
-    for (uint64_t y = 0; y < (console_height - 1) * CHAR_HEIGHT; y++) {
-      for (uint64_t x = 0; x < fb->width; x++) {
-        buffer[y * pitch_pixels + x] =
-            buffer[(y + CHAR_HEIGHT) * pitch_pixels + x];
-      }
-    }
-
-    for (uint64_t y = (console_height - 1) * CHAR_HEIGHT; y < fb->height; y++) {
-      for (uint64_t x = 0; x < fb->width; x++) {
-        buffer[y * pitch_pixels + x] = BG_COLOR;
-      }
-    }
-
+    console_scroll();
     cursor_y--;
   }
 }
 
+void console_putchar(char c) {
+  if (fb == NULL)
+    return;
+  console_emit(c);
+  console_flush();
+}
+
 static uint32_t ansi_to_color(int code) {
   switch (code) {
   case 30:
@@ -449,6 +715,9 @@ static uint32_t ansi_to_color(int code) {
 }
 
 void console_print(const char *str) {
+  if (fb == NULL)
+    return;
+
   while (*str) {
 
     if (*str == '\033') {
@@ -463,9 +732,9 @@ void console_print(const char *str) {
         }
         if (*str == 'm') {
           if (code == 0)
-            current_fg_color = 0xFFFFFF;
+            console_set_fg(0xFFFFFF);
           else
-            current_fg_color = ansi_to_color(code);
+            console_set_fg(ansi_to_color(code));
           str++;
         } else if (*str == ';') {
 
@@ -477,67 +746,78 @@ void console_print(const char *str) {
       }
       continue;
     }
-    console_putchar(*str++);
+    console_emit(*str++);
   }
+  console_flush();
 }
 
 void console_print_hex(uint64_t n) {
   char hex[] = "0123456789ABCDEF";
-  console_print("0x");
-  for (int i = 60; i >= 0; i -= 4) {
-    console_putchar(hex[(n >> i) & 0xF]);
-  }
+  char buf[19];
+  buf[0] = '0';
+  buf[1] = 'x';
+  for (int i = 0; i < 16; i++)
+    buf[2 + i] = hex[(n >> (60 - 4 * i)) & 0xF];
+  buf[18] = '\0';
+  console_print(buf);
 }
 
 void console_print_dec(uint64_t n) {
-  if (n == 0) {
-    console_putchar('0');
-    return;
-  }
-  char buf[20];
-  int i = 0;
-  while (n > 0) {
-    buf[i++] = (n % 10) + '0';
+  char buf[21];
+  int i = 20;
+  buf[i] = '\0';
+  do {
+    buf[--i] = (n % 10) + '0';
     n /= 10;
-  }
-  while (i > 0) {
-    console_putchar(buf[--i]);
-  }
+  } while (n > 0);
+  console_print(&buf[i]);
 }
 
 void console_clear(void) {
   if (fb == NULL)
     return;
 
-  for (uint32_t y = 0; y < fb->height; y++) {
-    for (uint32_t x = 0; x < fb->width; x++) {
-      put_pixel(x, y, BG_COLOR);
-    }
+  fb_fill_rect(0, 0, fb->width, fb->height, BG_COLOR);
+  for (uint32_t y = 0; y < console_height; y++) {
+    uint32_t ring = console_ring(y);
+    console_clear_row(console_cells[ring]);
+    dirty_lo[ring] = dirty_hi[ring] = 0;
   }
+  console_blank_shown(0, console_height);
+  view_offset = 0;
+  view_changed = 0;
+  pending_scroll = 0;
   cursor_x = 0;
   cursor_y = 0;
 }
 
 void console_backspace(void) {
+  if (fb == NULL)
+    return;
   if (cursor_x > 0) {
     cursor_x -= 1;
   } else if (cursor_y > 0) {
     cursor_y -= 1;
     cursor_x = console_width - 1;
   }
-
-  for (uint32_t py = 0; py < CHAR_HEIGHT; py++) {
-    uint32_t *dest = (uint32_t *)((uint8_t *)fb->address +
-                                  (cursor_y * CHAR_HEIGHT + py) * fb->pitch +
-                                  cursor_x * CHAR_WIDTH * 4);
-    for (uint32_t px = 0; px < CHAR_WIDTH; px++) {
-      dest[px] = BG_COLOR;
-    }
-  }
+  console_go_live();
+  console_set_cell(cursor_x, cursor_y, ' ', 0);
+  console_flush();
 }
 
 void console_set_cursor_visible(int visible) {
-  uint32_t color = visible ? 0xFFFFFFFF : 0;
+  if (fb == NULL || view_offset)
+    return;
+  console_flush();
+  struct console_cell *seen = &shown[cursor_y][cursor_x];
+  if (!visible) {
+    *seen = console_row(cursor_y)[cursor_x];
+    draw_char(cursor_x * CHAR_WIDTH, cursor_y * CHAR_HEIGHT, (char)seen->ch,
+              palette[seen->color], BG_COLOR);
+    return;
+  }
+  seen->color = CONSOLE_PALETTE;
+  uint32_t color = 0xFFFFFFFF;
 
   for (uint32_t py = 0; py < CHAR_HEIGHT; py++) {
     uint32_t *dest = (uint32_t *)((uint8_t *)fb->address +
@@ -630,5 +910,7 @@ void console_draw_cursor(int x, int y) {
   }
 }
 
+struct limine_framebuffer *console_get_framebuffer(void) { return fb; }
+
 uint32_t console_get_fb_width(void) { return fb ? fb->width : 0; }
 uint32_t console_get_fb_height(void) { return fb ? fb->height : 0; }
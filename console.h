@@ -17,6 +17,12 @@ void console_clear(void);
 void console_backspace(void);
 void console_set_cursor_visible(int visible);
 
+ 
+ 
+ 
+void console_scroll_view(int lines);
+uint32_t console_get_scrollback(void);
+
 uint32_t console_get_cursor_x(void);
 uint32_t console_get_cursor_y(void);
 void console_set_cursor(uint32_t x, uint32_t y);
@@ -24,6 +30,14 @@ uint32_t console_get_width(void);
 uint32_t console_get_height(void);
 
 void console_draw_cursor(int x, int y);
+
+ 
+ 
+void put_pixel(uint32_t x, uint32_t y, uint32_t color);
+void fb_blit_rect(int x, int y, int w, int h, const uint32_t *src,
+                  int src_stride);
+void fb_fill_rect(int x, int y, int w, int h, uint32_t color);
+struct limine_framebuffer *console_get_framebuffer(void);
 uint32_t console_get_fb_width(void);
 uint32_t console_get_fb_height(void);
 
@@ -0,0 +1,201 @@
+#include "crash.h"
+#include "console.h"
+#include "pmm.h"
+#include "string.h"
+#include "timer.h"
+#include <stddef.h>
+
+#define CRASH_RING_MAGIC 0x48435253
+#define CRASH_RECORD_MAGIC 0x48435244
+#define CRASH_RING_VERSION 1
+
+#define PSCI_SYSTEM_RESET 0x84000009
+
+struct crash_ring {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t boots;
+  uint32_t head;
+  uint64_t phys;
+  uint64_t reserved;
+  struct crash_record records[CRASH_RING_RECORDS];
+};
+
+_Static_assert(sizeof(struct crash_ring) <= CRASH_RING_SIZE,
+               "crash ring does not fit its reserved region");
+
+static struct crash_ring *ring = NULL;
+
+static uint32_t crash_checksum(const struct crash_record *rec) {
+  const uint8_t *p = (const uint8_t *)rec;
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < offsetof(struct crash_record, checksum); i++) {
+    hash ^= p[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static int crash_record_valid(const struct crash_record *rec) {
+  return rec->magic == CRASH_RECORD_MAGIC &&
+         rec->checksum == crash_checksum(rec);
+}
+
+static void crash_flush(const void *addr, size_t len) {
+  uint64_t start = (uint64_t)addr & ~63ull;
+  uint64_t end = (uint64_t)addr + len;
+  for (uint64_t line = start; line < end; line += 64)
+    __asm__ volatile("dc cvac, %0" ::"r"(line) : "memory");
+  __asm__ volatile("dsb sy" ::: "memory");
+}
+
+void crash_init(struct limine_memmap_response *memmap, uint64_t hhdm) {
+  uint64_t top = 0;
+  for (uint64_t i = 0; i < memmap->entry_count; i++) {
+    struct limine_memmap_entry *entry = memmap->entries[i];
+    if (entry->type != LIMINE_MEMMAP_USABLE)
+      continue;
+    uint64_t end = (entry->base + entry->length) & ~(uint64_t)4095;
+    if (end >= entry->base + CRASH_RING_SIZE && end > top)
+      top = end;
+  }
+  if (!top) {
+    console_print("CRASH: No memory for the crash ring\n");
+    return;
+  }
+
+  uint64_t phys = top - CRASH_RING_SIZE;
+  pmm_reserve(phys, CRASH_RING_SIZE);
+  ring = (struct crash_ring *)(phys + hhdm);
+
+  if (ring->magic != CRASH_RING_MAGIC ||
+      ring->version != CRASH_RING_VERSION || ring->phys != phys) {
+    k_memset(ring, 0, sizeof(*ring));
+    ring->magic = CRASH_RING_MAGIC;
+    ring->version = CRASH_RING_VERSION;
+    ring->phys = phys;
+  }
+  ring->boots++;
+  crash_flush(ring, sizeof(*ring));
+
+  uint32_t preserved = 0;
+  for (uint32_t i = 0; i < CRASH_RING_RECORDS; i++) {
+    if (crash_record_valid(&ring->records[i]))
+      preserved++;
+  }
+
+  console_print("CRASH: Ring at ");
+  console_print_hex(phys);
+  console_print(", boot ");
+  console_print_dec(ring->boots);
+  if (preserved) {
+    console_print(", ");
+    console_print_dec(preserved);
+    console_print(" record(s) preserved (run 'crashlog')");
+  }
+  console_print("\n");
+}
+
+int crash_save(uint32_t cpu, uint32_t kind, struct exception_frame *frame,
+               const uint64_t *pcs, uint32_t depth) {
+  if (!ring)
+    return -1;
+
+  uint32_t slot =
+      __atomic_fetch_add(&ring->head, 1, __ATOMIC_RELAXED) % CRASH_RING_RECORDS;
+  struct crash_record *rec = &ring->records[slot];
+
+  rec->magic = 0;
+  rec->boot = ring->boots;
+  rec->cpu = cpu;
+  rec->kind = kind;
+  rec->esr = frame->esr;
+  rec->far = frame->far;
+  rec->elr = frame->elr;
+  rec->spsr = frame->spsr;
+  rec->sp = frame->sp;
+  rec->lr = frame->x[30];
+  rec->timestamp = timer_read_counter();
+  if (depth > CRASH_BT_DEPTH)
+    depth = CRASH_BT_DEPTH;
+  for (uint32_t i = 0; i < CRASH_BT_DEPTH; i++)
+    rec->backtrace[i] = i < depth ? pcs[i] : 0;
+  rec->depth = depth;
+  rec->magic = CRASH_RECORD_MAGIC;
+  rec->checksum = crash_checksum(rec);
+
+  crash_flush(&ring->head, sizeof(ring->head));
+  crash_flush(rec, sizeof(*rec));
+  return 0;
+}
+
+void crash_print_log(void) {
+  if (!ring) {
+    console_print("No crash ring.\n");
+    return;
+  }
+
+  uint32_t head = ring->head;
+  uint32_t shown = 0;
+  for (uint32_t n = 0; n < CRASH_RING_RECORDS; n++) {
+    struct crash_record *rec =
+        &ring->records[(head + n) % CRASH_RING_RECORDS];
+    if (!crash_record_valid(rec))
+      continue;
+    shown++;
+
+    uint32_t ec = ESR_EC(rec->esr);
+    console_print("[boot ");
+    console_print_dec(rec->boot);
+    console_print(rec->boot == ring->boots ? " (this)" : "");
+    console_print(", CPU ");
+    console_print_dec(rec->cpu);
+    console_print(", t=");
+    console_print_dec(timer_ticks_to_ns(rec->timestamp) / 1000000);
+    console_print("ms] ");
+    console_print(exception_class_name(ec));
+    if (ec == ESR_EC_DABT_CUR || ec == ESR_EC_IABT_CUR) {
+      console_print(": ");
+      console_print(exception_fault_name(ESR_ISS(rec->esr) & 0x3F));
+    }
+    console_print("\n  ESR ");
+    console_print_hex(rec->esr);
+    console_print(" FAR ");
+    console_print_hex(rec->far);
+    console_print("\n  ELR ");
+    console_print_hex(rec->elr);
+    console_print(" LR  ");
+    console_print_hex(rec->lr);
+    console_print("\n  SP  ");
+    console_print_hex(rec->sp);
+    console_print(" SPSR ");
+    console_print_hex(rec->spsr);
+    console_print("\n  Backtrace:");
+    for (uint32_t i = 0; i < rec->depth && i < CRASH_BT_DEPTH; i++) {
+      console_print(" ");
+      console_print_hex(rec->backtrace[i]);
+    }
+    console_print("\n");
+  }
+
+  if (!shown)
+    console_print("No crashes recorded.\n");
+}
+
+void crash_clear(void) {
+  if (!ring)
+    return;
+  k_memset(ring->records, 0, sizeof(ring->records));
+  ring->head = 0;
+  crash_flush(ring, sizeof(*ring));
+}
+
+void crash_reboot(void) {
+  if (ring)
+    crash_flush(ring, sizeof(*ring));
+
+  register uint64_t x0 __asm__("x0") = PSCI_SYSTEM_RESET;
+  __asm__ volatile("hvc #0" : "+r"(x0)::"x1", "x2", "x3", "memory");
+
+  console_print("Reboot failed: PSCI SYSTEM_RESET returned.\n");
+}
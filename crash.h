@@ -0,0 +1,45 @@
+#ifndef CRASH_H
+#define CRASH_H
+
+#include "exception.h"
+#include "limine.h"
+#include <stdint.h>
+
+#define CRASH_RING_SIZE 4096
+#define CRASH_RING_RECORDS 16
+#define CRASH_BT_DEPTH 8
+
+ 
+ 
+struct crash_record {
+  uint32_t magic;
+  uint32_t boot;
+  uint32_t cpu;
+  uint32_t kind;
+  uint64_t esr;
+  uint64_t far;
+  uint64_t elr;
+  uint64_t spsr;
+  uint64_t sp;
+  uint64_t lr;
+  uint64_t timestamp;
+  uint64_t backtrace[CRASH_BT_DEPTH];
+  uint32_t depth;
+  uint32_t checksum;
+};
+
+ 
+ 
+void crash_init(struct limine_memmap_response *memmap, uint64_t hhdm);
+
+ 
+int crash_save(uint32_t cpu, uint32_t kind, struct exception_frame *frame,
+               const uint64_t *pcs, uint32_t depth);
+
+void crash_print_log(void);
+void crash_clear(void);
+
+ 
+void crash_reboot(void);
+
+#endif
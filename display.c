@@ -0,0 +1,455 @@
+#include "display.h"
+#include "blend.h"
+#include "console.h"
+#include "heap.h"
+#include "string.h"
+#include "virtio_gpu.h"
+#include <stddef.h>
+
+#define FW_CFG_BASE 0x09020000
+#define FW_CFG_DATA 0x00
+#define FW_CFG_SELECTOR 0x08
+#define FW_CFG_DMA 0x10
+
+#define FW_CFG_SIGNATURE 0x0000
+#define FW_CFG_ID 0x0001
+#define FW_CFG_FILE_DIR 0x0019
+#define FW_CFG_VERSION_DMA (1u << 1)
+
+#define FW_CFG_DMA_CTL_ERROR 0x01
+#define FW_CFG_DMA_CTL_SELECT 0x08
+#define FW_CFG_DMA_CTL_WRITE 0x10
+
+ 
+struct fw_cfg_file {
+  uint32_t size;
+  uint16_t select;
+  uint16_t reserved;
+  char name[56];
+} __attribute__((packed));
+
+struct fw_cfg_dma_access {
+  uint32_t control;
+  uint32_t length;
+  uint64_t address;
+} __attribute__((packed));
+
+struct ramfb_cfg {
+  uint64_t addr;
+  uint32_t fourcc;
+  uint32_t flags;
+  uint32_t width;
+  uint32_t height;
+  uint32_t stride;
+} __attribute__((packed));
+
+static uint64_t hhdm_offset = 0;
+static uint64_t kernel_vbase = 0;
+static uint64_t kernel_pbase = 0;
+
+static volatile uint8_t *fw_cfg = NULL;
+static uint16_t ramfb_select = 0;
+static struct ramfb_cfg ramfb_cfg __attribute__((aligned(16)));
+static struct fw_cfg_dma_access fw_cfg_dma __attribute__((aligned(16)));
+
+static const struct display_backend *backend = NULL;
+static struct display_surface surfaces[DISPLAY_MAX_SURFACES];
+static uint32_t *heap_pixels[DISPLAY_MAX_SURFACES];
+static int surface_count = 0;
+static int front = 0;
+static int back = 0;
+static uint32_t width = 0;
+static uint32_t height = 0;
+static uint32_t stride = 0;
+
+ 
+ 
+ 
+struct cursor_save {
+  int valid;
+  rect_t rect;
+  uint32_t pixels[DISPLAY_CURSOR_MAX * DISPLAY_CURSOR_MAX];
+};
+
+static uint32_t cursor_image[DISPLAY_CURSOR_MAX * DISPLAY_CURSOR_MAX];
+static int cursor_w = 0;
+static int cursor_h = 0;
+static int cursor_hot_x = 0;
+static int cursor_hot_y = 0;
+static int cursor_x = 0;
+static int cursor_y = 0;
+static int cursor_hw = 0;
+static struct cursor_save cursor_saves[DISPLAY_MAX_SURFACES];
+static rect_t cursor_restored;
+static region_t present_region;
+
+static uint64_t to_phys(const void *vaddr) {
+  return (uint64_t)vaddr - kernel_vbase + kernel_pbase;
+}
+
+static void fw_cfg_select(uint16_t key) {
+  *(volatile uint16_t *)(fw_cfg + FW_CFG_SELECTOR) = __builtin_bswap16(key);
+}
+
+static void fw_cfg_read(void *buf, size_t len) {
+  uint8_t *p = (uint8_t *)buf;
+  for (size_t i = 0; i < len; i++)
+    p[i] = fw_cfg[FW_CFG_DATA];
+}
+
+static int fw_cfg_dma_write(uint16_t key, const void *buf, uint32_t len) {
+  fw_cfg_dma.control = __builtin_bswap32(
+      ((uint32_t)key << 16) | FW_CFG_DMA_CTL_SELECT | FW_CFG_DMA_CTL_WRITE);
+  fw_cfg_dma.length = __builtin_bswap32(len);
+  fw_cfg_dma.address = __builtin_bswap64(to_phys(buf));
+
+  uint64_t desc = to_phys(&fw_cfg_dma);
+  __asm__ volatile("dsb sy" ::: "memory");
+  *(volatile uint32_t *)(fw_cfg + FW_CFG_DMA) =
+      __builtin_bswap32((uint32_t)(desc >> 32));
+  *(volatile uint32_t *)(fw_cfg + FW_CFG_DMA + 4) =
+      __builtin_bswap32((uint32_t)desc);
+
+  uint32_t control;
+  do {
+    control = __builtin_bswap32(*(volatile uint32_t *)&fw_cfg_dma.control);
+  } while (control & ~FW_CFG_DMA_CTL_ERROR);
+  return (control & FW_CFG_DMA_CTL_ERROR) ? -1 : 0;
+}
+
+static int ramfb_probe(void) {
+  fw_cfg = (volatile uint8_t *)(FW_CFG_BASE + hhdm_offset);
+
+  char sig[4];
+  fw_cfg_select(FW_CFG_SIGNATURE);
+  fw_cfg_read(sig, sizeof(sig));
+  if (sig[0] != 'Q' || sig[1] != 'E' || sig[2] != 'M' || sig[3] != 'U')
+    return -1;
+
+  uint8_t id[4];
+  fw_cfg_select(FW_CFG_ID);
+  fw_cfg_read(id, sizeof(id));
+  if (!(id[0] & FW_CFG_VERSION_DMA))
+    return -1;
+
+  uint32_t count;
+  fw_cfg_select(FW_CFG_FILE_DIR);
+  fw_cfg_read(&count, sizeof(count));
+  count = __builtin_bswap32(count);
+  for (uint32_t i = 0; i < count; i++) {
+    struct fw_cfg_file file;
+    fw_cfg_read(&file, sizeof(file));
+    file.name[sizeof(file.name) - 1] = '\0';
+    if (k_strcmp(file.name, "etc/ramfb") == 0) {
+      ramfb_select = __builtin_bswap16(file.select);
+      break;
+    }
+  }
+  if (!ramfb_select)
+    return -1;
+
+ 
+ 
+  fw_cfg_select(ramfb_select);
+  fw_cfg_read(&ramfb_cfg, sizeof(ramfb_cfg));
+  return 0;
+}
+
+static int ramfb_flip(struct display_surface *surface, const region_t *damage) {
+  (void)damage;
+  ramfb_cfg.addr = __builtin_bswap64(surface->phys);
+  return fw_cfg_dma_write(ramfb_select, &ramfb_cfg, sizeof(ramfb_cfg));
+}
+
+static int copy_flip(struct display_surface *surface, const region_t *damage) {
+  for (int i = 0; i < damage->count; i++) {
+    const rect_t *r = &damage->rects[i];
+    fb_blit_rect(r->x0, r->y0, r->x1 - r->x0, r->y1 - r->y0,
+                 &surface->pixels[r->y0 * stride + r->x0], (int)stride);
+  }
+  return 0;
+}
+
+static int virtio_gpu_backend_attach(struct display_surface *surface) {
+  return virtio_gpu_attach((uint32_t)surface->index, surface->phys);
+}
+
+static int virtio_gpu_flip(struct display_surface *surface,
+                           const region_t *damage) {
+  return virtio_gpu_present((uint32_t)surface->index, damage);
+}
+
+static void virtio_gpu_sync(struct display_surface *surface) {
+  virtio_gpu_wait((uint32_t)surface->index);
+}
+
+static int virtio_gpu_backend_cursor_set(const uint32_t *argb, int w, int h,
+                                         int hot_x, int hot_y) {
+  return virtio_gpu_cursor_set(argb, w, h, hot_x, hot_y, cursor_x, cursor_y);
+}
+
+static const struct display_backend ramfb_backend = {
+    .name = "ramfb",
+    .zero_copy = 1,
+    .max_surfaces = DISPLAY_MAX_SURFACES,
+    .flip = ramfb_flip,
+};
+
+static const struct display_backend copy_backend = {
+    .name = "copy",
+    .zero_copy = 0,
+    .max_surfaces = 1,
+    .flip = copy_flip,
+};
+
+static const struct display_backend virtio_gpu_backend = {
+    .name = "virtio-gpu",
+    .zero_copy = 0,
+    .max_surfaces = VIRTIO_GPU_MAX_SLOTS,
+    .attach = virtio_gpu_backend_attach,
+    .flip = virtio_gpu_flip,
+    .sync = virtio_gpu_sync,
+    .cursor_set = virtio_gpu_backend_cursor_set,
+    .cursor_move = virtio_gpu_cursor_move,
+};
+
+void display_init(uint64_t hhdm, uint64_t vbase, uint64_t pbase) {
+  hhdm_offset = hhdm;
+  kernel_vbase = vbase;
+  kernel_pbase = pbase;
+  backend = NULL;
+
+   
+   
+  struct limine_framebuffer *fb = console_get_framebuffer();
+  if (virtio_gpu_init(hhdm, vbase, pbase) == 0) {
+    backend = &virtio_gpu_backend;
+    width = virtio_gpu_width();
+    height = virtio_gpu_height();
+  } else if (fb) {
+    backend = &copy_backend;
+    width = (uint32_t)fb->width;
+    height = (uint32_t)fb->height;
+
+     
+     
+    uint64_t fb_phys = (uint64_t)fb->address - hhdm_offset;
+    if (ramfb_probe() == 0 &&
+        __builtin_bswap64(ramfb_cfg.addr) == fb_phys &&
+        __builtin_bswap32(ramfb_cfg.stride) == fb->pitch)
+      backend = &ramfb_backend;
+  } else {
+    return;
+  }
+
+  console_print("DISPLAY: ");
+  console_print(backend->name);
+  console_print(backend->zero_copy ? " page flipping (zero-copy)\n"
+                                   : " presentation\n");
+}
+
+static uint32_t *surface_alloc(int i, uint64_t bytes) {
+  if (!heap_pixels[i]) {
+    heap_pixels[i] = (uint32_t *)malloc(bytes);
+    if (heap_pixels[i])
+      k_memset(heap_pixels[i], 0, bytes);
+  }
+  return heap_pixels[i];
+}
+
+int display_open(int count) {
+  if (!backend)
+    return 0;
+  if (count > backend->max_surfaces)
+    count = backend->max_surfaces;
+
+  surface_count = 0;
+  front = 0;
+  back = 0;
+
+  struct limine_framebuffer *fb = console_get_framebuffer();
+  if (backend == &ramfb_backend) {
+    stride = (uint32_t)(fb->pitch / 4);
+    uint64_t bytes = (uint64_t)fb->pitch * fb->height;
+    surfaces[0].pixels = (uint32_t *)fb->address;
+    surfaces[0].phys = (uint64_t)fb->address - hhdm_offset;
+    surface_count = 1;
+    for (int i = 1; i < count; i++) {
+      uint32_t *pixels = surface_alloc(i, bytes);
+      if (!pixels)
+        break;
+      surfaces[i].pixels = pixels;
+      surfaces[i].phys = to_phys(pixels);
+      surface_count++;
+    }
+    if (surface_count > 1) {
+      back = 1;
+    } else {
+      backend = &copy_backend;
+      count = 1;
+      surface_count = 0;
+      console_print("DISPLAY: No memory for flip surfaces, copying\n");
+    }
+  }
+
+  if (!surface_count) {
+    stride = width;
+    for (int i = 0; i < count; i++) {
+      uint32_t *pixels = surface_alloc(i, (uint64_t)width * height * 4);
+      if (!pixels)
+        break;
+      surfaces[i].pixels = pixels;
+      surfaces[i].phys = to_phys(pixels);
+      surfaces[i].index = i;
+      if (backend->attach && backend->attach(&surfaces[i]) < 0)
+        break;
+      surface_count++;
+    }
+  }
+
+  for (int i = 0; i < surface_count; i++) {
+    surfaces[i].index = i;
+    surfaces[i].age = 0;
+    cursor_saves[i].valid = 0;
+  }
+  return surface_count;
+}
+
+void display_close(void) {
+  if (surface_count && backend == &ramfb_backend && front != 0)
+    backend->flip(&surfaces[0], NULL);
+  surface_count = 0;
+  front = 0;
+  back = 0;
+}
+
+static rect_t cursor_rect(void) {
+  rect_t r = rect_make(cursor_x - cursor_hot_x, cursor_y - cursor_hot_y,
+                       cursor_w, cursor_h);
+  rect_t screen = rect_make(0, 0, (int)width, (int)height);
+  if (!rect_intersect(&r, &screen, &r))
+    r = rect_make(0, 0, 0, 0);
+  return r;
+}
+
+static void cursor_restore(struct display_surface *surface) {
+  struct cursor_save *save = &cursor_saves[surface->index];
+  cursor_restored = rect_make(0, 0, 0, 0);
+  if (!save->valid)
+    return;
+
+  const rect_t *r = &save->rect;
+  int w = r->x1 - r->x0;
+  for (int y = r->y0; y < r->y1; y++) {
+    uint32_t *dst = &surface->pixels[y * stride + r->x0];
+    const uint32_t *src = &save->pixels[(y - r->y0) * w];
+    for (int x = 0; x < w; x++)
+      dst[x] = src[x];
+  }
+  cursor_restored = *r;
+  save->valid = 0;
+}
+
+static void cursor_draw(struct display_surface *surface) {
+  struct cursor_save *save = &cursor_saves[surface->index];
+  rect_t r = cursor_rect();
+  if (rect_empty(&r))
+    return;
+
+  int w = r.x1 - r.x0;
+  int ox = cursor_x - cursor_hot_x;
+  int oy = cursor_y - cursor_hot_y;
+  for (int y = r.y0; y < r.y1; y++) {
+    uint32_t *dst = &surface->pixels[y * stride + r.x0];
+    uint32_t *saved = &save->pixels[(y - r.y0) * w];
+    const uint32_t *src = &cursor_image[(y - oy) * cursor_w + (r.x0 - ox)];
+    for (int x = 0; x < w; x++) {
+      saved[x] = dst[x];
+      uint8_t alpha = (uint8_t)(src[x] >> 24);
+      if (alpha == 255)
+        dst[x] = src[x] & 0xFFFFFF;
+      else if (alpha)
+        dst[x] = blend_pixel(src[x], dst[x], alpha) & 0xFFFFFF;
+    }
+  }
+  save->rect = r;
+  save->valid = 1;
+}
+
+int display_cursor_set(const uint32_t *argb, int w, int h, int hot_x,
+                       int hot_y) {
+  if (!backend || w > DISPLAY_CURSOR_MAX || h > DISPLAY_CURSOR_MAX)
+    return -1;
+
+  for (int i = 0; i < w * h; i++)
+    cursor_image[i] = argb[i];
+  cursor_w = w;
+  cursor_h = h;
+  cursor_hot_x = hot_x;
+  cursor_hot_y = hot_y;
+
+  cursor_hw = backend->cursor_set &&
+              backend->cursor_set(argb, w, h, hot_x, hot_y) == 0;
+  return 0;
+}
+
+int display_cursor_move(int x, int y) {
+  if (x == cursor_x && y == cursor_y)
+    return 0;
+  cursor_x = x;
+  cursor_y = y;
+  if (cursor_hw) {
+    backend->cursor_move(x, y);
+    return 0;
+  }
+  return cursor_w > 0;
+}
+
+uint32_t *display_acquire(int *age) {
+  if (!surface_count)
+    return NULL;
+  struct display_surface *surface = &surfaces[back];
+  if (backend->sync)
+    backend->sync(surface);
+  if (!cursor_hw)
+    cursor_restore(surface);
+  if (age)
+    *age = surface->age;
+  return surface->pixels;
+}
+
+void display_present(const region_t *damage) {
+  if (!surface_count)
+    return;
+
+  struct display_surface *surface = &surfaces[back];
+  present_region = *damage;
+  if (!cursor_hw && cursor_w) {
+    region_add(&present_region, cursor_restored);
+    cursor_draw(surface);
+    if (cursor_saves[surface->index].valid)
+      region_add(&present_region, cursor_saves[surface->index].rect);
+  }
+  backend->flip(surface, &present_region);
+
+  for (int i = 0; i < surface_count; i++) {
+    if (surfaces[i].age)
+      surfaces[i].age++;
+  }
+  surface->age = 1;
+
+  front = back;
+  back = (back + 1) % surface_count;
+}
+
+uint32_t display_width(void) { return width; }
+
+uint32_t display_height(void) { return height; }
+
+uint32_t display_stride(void) { return stride; }
+
+int display_surface_count(void) { return surface_count; }
+
+const char *display_backend_name(void) {
+  return backend ? backend->name : "none";
+}
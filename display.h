@@ -0,0 +1,61 @@
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include "region.h"
+#include <stdint.h>
+
+#define DISPLAY_MAX_SURFACES 3
+#define DISPLAY_CURSOR_MAX 32
+
+ 
+ 
+ 
+struct display_surface {
+  int index;
+  uint32_t *pixels;
+  uint64_t phys;
+  int age;
+};
+
+ 
+ 
+ 
+struct display_backend {
+  const char *name;
+  int zero_copy;
+  int max_surfaces;
+  int (*attach)(struct display_surface *surface);
+  int (*flip)(struct display_surface *surface, const region_t *damage);
+  void (*sync)(struct display_surface *surface);
+  int (*cursor_set)(const uint32_t *argb, int w, int h, int hot_x, int hot_y);
+  void (*cursor_move)(int x, int y);
+};
+
+ 
+void display_init(uint64_t hhdm, uint64_t kernel_vbase, uint64_t kernel_pbase);
+
+ 
+ 
+int display_open(int surfaces);
+void display_close(void);
+
+ 
+ 
+uint32_t *display_acquire(int *age);
+void display_present(const region_t *damage);
+
+ 
+ 
+ 
+ 
+int display_cursor_set(const uint32_t *argb, int w, int h, int hot_x,
+                       int hot_y);
+int display_cursor_move(int x, int y);
+
+uint32_t display_width(void);
+uint32_t display_height(void);
+uint32_t display_stride(void);
+int display_surface_count(void);
+const char *display_backend_name(void);
+
+#endif
@@ -0,0 +1,252 @@
+#include "exception.h"
+#include "console.h"
+#include "crash.h"
+#include "printk.h"
+#include "smp.h"
+#include "uart.h"
+#include <stddef.h>
+
+#define EXC_STACK_LIMIT 0x10000
+#define EXC_BT_DEPTH 16
+
+static fault_handler_t fault_handler = NULL;
+static uint32_t exception_depth[MAX_CPUS];
+
+static const char *exception_kinds[16] = {
+    "Synchronous (EL1t)",    "IRQ (EL1t)",    "FIQ (EL1t)",
+    "SError (EL1t)",         "Synchronous",   "IRQ",
+    "FIQ",                   "SError",        "Synchronous (EL0)",
+    "IRQ (EL0)",             "FIQ (EL0)",     "SError (EL0)",
+    "Synchronous (AArch32)", "IRQ (AArch32)", "FIQ (AArch32)",
+    "SError (AArch32)",
+};
+
+ 
+static void exc_print(const char *str) {
+  printk_flush();
+  console_print(str);
+  uart_flush();
+  for (; *str; str++) {
+    if (*str == '\n')
+      uart_putc_sync('\r');
+    uart_putc_sync(*str);
+  }
+}
+
+static void exc_print_hex(uint64_t n) {
+  char buf[19];
+  const char *hex = "0123456789ABCDEF";
+  buf[0] = '0';
+  buf[1] = 'x';
+  for (int i = 0; i < 16; i++)
+    buf[2 + i] = hex[(n >> (60 - i * 4)) & 0xF];
+  buf[18] = 0;
+  exc_print(buf);
+}
+
+static void exc_print_dec(uint64_t n) {
+  char buf[21];
+  int i = 20;
+  buf[i] = 0;
+  do {
+    buf[--i] = '0' + (n % 10);
+    n /= 10;
+  } while (n);
+  exc_print(&buf[i]);
+}
+
+static void exc_halt(void) {
+  for (;;) {
+    __asm__ volatile("msr daifset, #0xf\n"
+                     "wfi");
+  }
+}
+
+void exception_set_fault_handler(fault_handler_t handler) {
+  fault_handler = handler;
+}
+
+const char *exception_class_name(uint32_t ec) {
+  switch (ec) {
+  case ESR_EC_UNKNOWN:
+    return "Unknown reason";
+  case 0x01:
+    return "Trapped WFI/WFE";
+  case 0x07:
+    return "FP/SIMD access trap";
+  case 0x0E:
+    return "Illegal execution state";
+  case 0x15:
+    return "SVC (AArch64)";
+  case 0x16:
+    return "HVC (AArch64)";
+  case 0x18:
+    return "Trapped MSR/MRS";
+  case ESR_EC_IABT_LOWER:
+    return "Instruction abort (lower EL)";
+  case ESR_EC_IABT_CUR:
+    return "Instruction abort";
+  case ESR_EC_PC_ALIGN:
+    return "PC alignment fault";
+  case ESR_EC_DABT_LOWER:
+    return "Data abort (lower EL)";
+  case ESR_EC_DABT_CUR:
+    return "Data abort";
+  case ESR_EC_SP_ALIGN:
+    return "SP alignment fault";
+  case 0x2F:
+    return "SError";
+  case 0x30:
+  case 0x31:
+    return "Breakpoint";
+  case 0x32:
+  case 0x33:
+    return "Software step";
+  case 0x34:
+  case 0x35:
+    return "Watchpoint";
+  case ESR_EC_BRK:
+    return "BRK instruction";
+  default:
+    return "Reserved";
+  }
+}
+
+const char *exception_fault_name(uint32_t fsc) {
+  switch (fsc & 0x3C) {
+  case 0x00:
+    return "Address size fault";
+  case 0x04:
+    return "Translation fault";
+  case 0x08:
+    return "Access flag fault";
+  case 0x0C:
+    return "Permission fault";
+  }
+  switch (fsc) {
+  case 0x10:
+    return "Synchronous external abort";
+  case 0x21:
+    return "Alignment fault";
+  case 0x30:
+    return "TLB conflict abort";
+  default:
+    return "Unknown fault";
+  }
+}
+
+ 
+ 
+uint32_t exception_backtrace(uint64_t fp, uint64_t sp, uint64_t *pcs,
+                             uint32_t max) {
+  uint32_t n = 0;
+  while (n < max) {
+    if (fp & 0xF || fp < sp || fp >= sp + EXC_STACK_LIMIT)
+      break;
+    uint64_t next = ((uint64_t *)fp)[0];
+    uint64_t lr = ((uint64_t *)fp)[1];
+    if (!lr)
+      break;
+    pcs[n++] = lr;
+    if (next <= fp)
+      break;
+    fp = next;
+  }
+  return n;
+}
+
+static int exception_is_abort(uint32_t ec) {
+  return ec == ESR_EC_DABT_CUR || ec == ESR_EC_DABT_LOWER ||
+         ec == ESR_EC_IABT_CUR || ec == ESR_EC_IABT_LOWER;
+}
+
+static void exception_dump_regs(struct exception_frame *frame) {
+  for (int i = 0; i < 31; i++) {
+    exc_print(i < 10 ? " x" : "x");
+    exc_print_dec(i);
+    exc_print(": ");
+    exc_print_hex(frame->x[i]);
+    exc_print((i % 3 == 2 || i == 30) ? "\n" : "  ");
+  }
+  exc_print(" sp: ");
+  exc_print_hex(frame->sp);
+  exc_print("  elr: ");
+  exc_print_hex(frame->elr);
+  exc_print("  spsr: ");
+  exc_print_hex(frame->spsr);
+  exc_print("\n");
+}
+
+void exception_handler(struct exception_frame *frame, uint64_t kind) {
+  uint32_t cpu = smp_processor_id();
+  uint32_t ec = ESR_EC(frame->esr);
+
+  if (kind == EXC_KIND_SYNC_EL1H && fault_handler && exception_is_abort(ec) &&
+      exception_depth[cpu] == 0) {
+    exception_depth[cpu]++;
+    int handled = fault_handler(frame) == 0;
+    exception_depth[cpu]--;
+    if (handled)
+      return;
+  }
+
+  if (exception_depth[cpu]++ > 0) {
+    exc_print("\nKERNEL PANIC: Exception while handling an exception, ELR ");
+    exc_print_hex(frame->elr);
+    exc_print("\n");
+    exc_halt();
+  }
+
+  exc_print("\n*** KERNEL PANIC: ");
+  exc_print(exception_kinds[kind & 0xF]);
+  exc_print(" exception on CPU ");
+  exc_print_dec(cpu);
+  exc_print(" ***\n");
+
+  exc_print("ESR: ");
+  exc_print_hex(frame->esr);
+  exc_print(" (");
+  exc_print(exception_class_name(ec));
+  exc_print(")\n");
+
+  if (exception_is_abort(ec)) {
+    uint32_t iss = ESR_ISS(frame->esr);
+    exc_print("Fault: ");
+    exc_print(exception_fault_name(iss & 0x3F));
+    if ((iss & 0x3C) <= 0x0C) {
+      exc_print(" (level ");
+      exc_print_dec(iss & 3);
+      exc_print(")");
+    }
+    if (ec == ESR_EC_DABT_CUR || ec == ESR_EC_DABT_LOWER)
+      exc_print((iss & ESR_ABT_WNR) ? " on write" : " on read");
+    exc_print(", FAR ");
+    if (iss & ESR_ABT_FNV)
+      exc_print("not valid");
+    else
+      exc_print_hex(frame->far);
+    exc_print("\n");
+  }
+
+  exception_dump_regs(frame);
+
+  uint64_t pcs[EXC_BT_DEPTH];
+  uint32_t depth = exception_backtrace(frame->x[29], frame->sp, pcs,
+                                       EXC_BT_DEPTH);
+
+  int saved = crash_save(cpu, (uint32_t)kind, frame, pcs, depth);
+
+  exc_print("Backtrace:\n  ");
+  exc_print_hex(frame->elr);
+  exc_print("\n");
+  for (uint32_t i = 0; i < depth; i++) {
+    exc_print("  ");
+    exc_print_hex(pcs[i]);
+    exc_print("\n");
+  }
+
+  if (saved == 0)
+    exc_print("Crash record saved, run 'crashlog' after reboot.\n");
+  exc_print("System halted.\n");
+  exc_halt();
+}
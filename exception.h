@@ -0,0 +1,43 @@
+#ifndef EXCEPTION_H
+#define EXCEPTION_H
+
+#include <stdint.h>
+
+#define EXC_KIND_SYNC_EL1H 4
+
+#define ESR_EC(esr) (((esr) >> 26) & 0x3F)
+#define ESR_ISS(esr) ((esr) & 0x1FFFFFF)
+
+#define ESR_EC_UNKNOWN 0x00
+#define ESR_EC_IABT_LOWER 0x20
+#define ESR_EC_IABT_CUR 0x21
+#define ESR_EC_PC_ALIGN 0x22
+#define ESR_EC_DABT_LOWER 0x24
+#define ESR_EC_DABT_CUR 0x25
+#define ESR_EC_SP_ALIGN 0x26
+#define ESR_EC_BRK 0x3C
+
+#define ESR_ABT_WNR (1u << 6)
+#define ESR_ABT_FNV (1u << 10)
+
+ 
+struct exception_frame {
+  uint64_t x[31];
+  uint64_t sp;
+  uint64_t elr;
+  uint64_t spsr;
+  uint64_t esr;
+  uint64_t far;
+};
+
+ 
+ 
+typedef int (*fault_handler_t)(struct exception_frame *frame);
+
+void exception_set_fault_handler(fault_handler_t handler);
+const char *exception_class_name(uint32_t ec);
+const char *exception_fault_name(uint32_t fsc);
+uint32_t exception_backtrace(uint64_t fp, uint64_t sp, uint64_t *pcs,
+                             uint32_t max);
+
+#endif
@@ -1,5 +1,16 @@
 #include "gic.h"
-#include "console.h"
+#include "printk.h"
+#include "smp.h"
+
+static uint64_t gicd_base = GICD_BASE;
+static uint64_t gicc_base = GICC_BASE;
+static uint64_t gicr_base = GICR_BASE;
+static uint32_t gic_arch = 2;
+static uint32_t gic_lines = 32;
+
+static uint64_t gicr_cpu_base[MAX_CPUS];
+static uint64_t gic_cpu_affinity[MAX_CPUS];
+static uint8_t gic_cpu_itargets[MAX_CPUS];
 
  
 static inline void mmio_write(uint64_t addr, uint32_t val) {
@@ -10,23 +21,140 @@ static inline uint32_t mmio_read(uint64_t addr) {
   return *(volatile uint32_t *)addr;
 }
 
-void gic_init(void) {
-   
-  mmio_write(GICD_CTLR, 0);
+static inline void mmio_write64(uint64_t addr, uint64_t val) {
+  *(volatile uint64_t *)addr = val;
+}
+
+static inline uint64_t mmio_read64(uint64_t addr) {
+  return *(volatile uint64_t *)addr;
+}
+
+static inline uint64_t read_mpidr(void) {
+  uint64_t val;
+  __asm__ volatile("mrs %0, mpidr_el1" : "=r"(val));
+  return val;
+}
+
+static void gic_wait_rwp(void) {
+  while (mmio_read(gicd_base + GICD_CTLR) & GICD_CTLR_RWP)
+    ;
+}
+
+void gic_init(uint64_t hhdm) {
+  gicd_base = GICD_BASE + hhdm;
+  gicc_base = GICC_BASE + hhdm;
+  gicr_base = GICR_BASE + hhdm;
+
+  gic_arch = (mmio_read(gicd_base + GICD_PIDR2) >> 4) & 0xF;
+  if (gic_arch < 3)
+    gic_arch = 2;
+  gic_lines = ((mmio_read(gicd_base + GICD_TYPER) & 0x1F) + 1) * 32;
+  if (gic_lines > 1020)
+    gic_lines = 1020;
 
    
-  mmio_write(GICD_CTLR, 1);
+  mmio_write(gicd_base + GICD_CTLR, 0);
+
+  if (gic_arch >= 3) {
+    gic_wait_rwp();
+    for (uint32_t i = 1; i < gic_lines / 32; i++) {
+      mmio_write(gicd_base + GICD_IGROUPR + i * 4, 0xFFFFFFFF);
+    }
+    mmio_write(gicd_base + GICD_CTLR, GICD_CTLR_ARE);
+    gic_wait_rwp();
+    mmio_write(gicd_base + GICD_CTLR,
+               GICD_CTLR_ARE | GICD_CTLR_ENABLE_G1A | GICD_CTLR_ENABLE_G1);
+    gic_wait_rwp();
+  } else {
+     
+    mmio_write(gicd_base + GICD_CTLR, 1);
+  }
+
+  printk(PRINTK_INFO, "GIC: v%u initialized, %u IRQ lines.\n", gic_arch,
+         gic_lines);
+}
+
+static uint64_t gic_find_redistributor(uint64_t mpidr) {
+  uint32_t aff = (uint32_t)(((mpidr >> 8) & 0xFF000000) | (mpidr & 0xFFFFFF));
+  for (uint64_t rd = gicr_base;; rd += GICR_STRIDE) {
+    uint64_t typer = mmio_read64(rd + GICR_TYPER);
+    if ((uint32_t)(typer >> 32) == aff)
+      return rd;
+    if (typer & GICR_TYPER_LAST)
+      return 0;
+  }
+}
+
+static void gic_cpu_init_v3(uint32_t cpu, uint64_t mpidr) {
+  uint64_t rd = gic_find_redistributor(mpidr);
+  if (!rd) {
+    printk(PRINTK_ERR, "GIC: No redistributor for MPIDR 0x%016lx\n", mpidr);
+    return;
+  }
+  gicr_cpu_base[cpu] = rd;
+
+  mmio_write(rd + GICR_WAKER,
+             mmio_read(rd + GICR_WAKER) & ~GICR_WAKER_PROCESSOR_SLEEP);
+  while (mmio_read(rd + GICR_WAKER) & GICR_WAKER_CHILDREN_ASLEEP)
+    ;
+
+  uint64_t sgi = rd + GICR_SGI_OFFSET;
+  mmio_write(sgi + GICR_IGROUPR0, 0xFFFFFFFF);
+  for (uint32_t i = 0; i < 32 / 4; i++) {
+    mmio_write(sgi + GICR_IPRIORITYR + i * 4, 0x80808080);
+  }
+  mmio_write(sgi + GICR_ISENABLER0, (1 << GIC_NR_SGIS) - 1);
+
+  uint64_t sre;
+  __asm__ volatile("mrs %0, icc_sre_el1" : "=r"(sre));
+  __asm__ volatile("msr icc_sre_el1, %0\n"
+                   "isb" ::"r"(sre | 1));
+
+  __asm__ volatile("msr icc_pmr_el1, %0" ::"r"((uint64_t)0xFF));
+  __asm__ volatile("msr icc_bpr1_el1, %0" ::"r"((uint64_t)0));
+  __asm__ volatile("msr icc_igrpen1_el1, %0\n"
+                   "isb" ::"r"((uint64_t)1));
+}
+
+void gic_cpu_init(void) {
+  uint32_t cpu = smp_processor_id();
+  uint64_t mpidr = read_mpidr();
+  gic_cpu_affinity[cpu] = mpidr & 0xFF00FFFFFFull;
+
+  if (gic_arch >= 3) {
+    gic_cpu_init_v3(cpu, mpidr);
+    return;
+  }
+
+  gic_cpu_itargets[cpu] = mmio_read(gicd_base + GICD_ITARGETSR) & 0xFF;
+
+  for (uint32_t i = 0; i < GIC_NR_SGIS / 4; i++) {
+    mmio_write(gicd_base + GICD_IPRIORITYR + i * 4, 0x80808080);
+  }
+  mmio_write(gicd_base + GICD_ISENABLER, (1 << GIC_NR_SGIS) - 1);
 
    
-  mmio_write(GICC_PMR, 0xFF);
+  mmio_write(gicc_base + GICC_PMR, 0xFF);
 
    
-  mmio_write(GICC_CTLR, 1);
+  mmio_write(gicc_base + GICC_CTLR, 1);
+}
+
+uint32_t gic_version(void) { return gic_arch; }
 
-  console_print("GIC: Initialized.\n");
+uint32_t gic_max_cpus(void) {
+  return gic_arch >= 3 ? MAX_CPUS : GIC_V2_MAX_CPUS;
 }
 
 void gic_enable_irq(uint32_t irq) {
+  uint32_t cpu = smp_processor_id();
+  uint64_t base = gicd_base;
+  if (gic_arch >= 3 && irq < 32) {
+    if (!gicr_cpu_base[cpu])
+      return;
+    base = gicr_cpu_base[cpu] + GICR_SGI_OFFSET;
+  }
+
    
   uint32_t reg = irq / 32;
   uint32_t bit = irq % 32;
@@ -34,7 +162,7 @@ void gic_enable_irq(uint32_t irq) {
    
   uint32_t prio_reg = irq / 4;
   uint32_t prio_shift = (irq % 4) * 8;
-  uint64_t prio_addr = GICD_IPRIORITYR + prio_reg * 4;
+  uint64_t prio_addr = base + GICD_IPRIORITYR + prio_reg * 4;
   uint32_t prio_val = mmio_read(prio_addr);
   prio_val &= ~(0xFF << prio_shift);
   prio_val |= (0x80 << prio_shift);  
@@ -42,20 +170,79 @@ void gic_enable_irq(uint32_t irq) {
 
    
   if (irq >= 32) {
-    uint32_t target_reg = irq / 4;
-    uint32_t target_shift = (irq % 4) * 8;
-    uint64_t target_addr = GICD_ITARGETSR + target_reg * 4;
-    uint32_t target_val = mmio_read(target_addr);
-    target_val |= (1 << target_shift);  
-    mmio_write(target_addr, target_val);
+    if (gic_arch >= 3) {
+      mmio_write64(gicd_base + GICD_IROUTER + irq * 8, gic_cpu_affinity[cpu]);
+    } else {
+      uint32_t target_reg = irq / 4;
+      uint32_t target_shift = (irq % 4) * 8;
+      uint64_t target_addr = gicd_base + GICD_ITARGETSR + target_reg * 4;
+      uint32_t target_val = mmio_read(target_addr);
+      target_val &= ~(0xFF << target_shift);
+      target_val |= ((uint32_t)gic_cpu_itargets[cpu] << target_shift);
+      mmio_write(target_addr, target_val);
+    }
   }
 
    
-  mmio_write(GICD_ISENABLER + reg * 4, 1 << bit);
+  mmio_write(base + GICD_ISENABLER + reg * 4, 1 << bit);
 }
 
 uint32_t gic_acknowledge(void) {
-  return mmio_read(GICC_IAR) & 0x3FF;  
+  if (gic_arch >= 3) {
+    uint64_t iar;
+    __asm__ volatile("mrs %0, icc_iar1_el1" : "=r"(iar)::"memory");
+    return (uint32_t)iar;
+  }
+  return mmio_read(gicc_base + GICC_IAR);
 }
 
-void gic_end_of_interrupt(uint32_t irq) { mmio_write(GICC_EOIR, irq); }
+void gic_end_of_interrupt(uint32_t iar) {
+  if (gic_arch >= 3) {
+    __asm__ volatile("msr icc_eoir1_el1, %0\n"
+                     "isb" ::"r"((uint64_t)iar)
+                     : "memory");
+    return;
+  }
+  mmio_write(gicc_base + GICC_EOIR, iar);
+}
+
+static void gic_send_sgi_v3(uint64_t cpu_mask, uint32_t sgi) {
+  while (cpu_mask) {
+    uint32_t first = __builtin_ctzll(cpu_mask);
+    uint64_t cluster = gic_cpu_affinity[first] & ~0xFull;
+    uint64_t list = 0;
+
+    for (uint32_t cpu = first; cpu < MAX_CPUS; cpu++) {
+      if (!(cpu_mask & (1ull << cpu)))
+        continue;
+      if ((gic_cpu_affinity[cpu] & ~0xFull) != cluster)
+        continue;
+      list |= 1ull << (gic_cpu_affinity[cpu] & 0xF);
+      cpu_mask &= ~(1ull << cpu);
+    }
+
+    uint64_t val = list | (((cluster >> 8) & 0xFF) << 16) |
+                   ((uint64_t)(sgi & 0xF) << 24) |
+                   (((cluster >> 16) & 0xFF) << 32) |
+                   (((cluster >> 4) & 0xF) << 44) |
+                   (((cluster >> 32) & 0xFF) << 48);
+    __asm__ volatile("msr icc_sgi1r_el1, %0" ::"r"(val));
+  }
+  __asm__ volatile("isb");
+}
+
+void gic_send_sgi(uint64_t cpu_mask, uint32_t sgi) {
+  __asm__ volatile("dsb ishst" ::: "memory");
+
+  if (gic_arch >= 3) {
+    gic_send_sgi_v3(cpu_mask, sgi);
+    return;
+  }
+
+  uint32_t targets = 0;
+  for (uint32_t cpu = 0; cpu < GIC_V2_MAX_CPUS; cpu++) {
+    if (cpu_mask & (1ull << cpu))
+      targets |= gic_cpu_itargets[cpu];
+  }
+  mmio_write(gicd_base + GICD_SGIR, (targets << 16) | (sgi & 0xF));
+}
@@ -6,27 +6,60 @@
  
 #define GICD_BASE 0x08000000  
 #define GICC_BASE 0x08010000  
+#define GICR_BASE 0x080A0000
 
  
-#define GICD_CTLR (GICD_BASE + 0x000)
-#define GICD_ISENABLER (GICD_BASE + 0x100)
-#define GICD_ICENABLER (GICD_BASE + 0x180)
-#define GICD_IPRIORITYR (GICD_BASE + 0x400)
-#define GICD_ITARGETSR (GICD_BASE + 0x800)
-#define GICD_ICFGR (GICD_BASE + 0xC00)
+#define GICD_CTLR 0x000
+#define GICD_TYPER 0x004
+#define GICD_IGROUPR 0x080
+#define GICD_ISENABLER 0x100
+#define GICD_ICENABLER 0x180
+#define GICD_IPRIORITYR 0x400
+#define GICD_ITARGETSR 0x800
+#define GICD_ICFGR 0xC00
+#define GICD_SGIR 0xF00
+#define GICD_IROUTER 0x6000
+#define GICD_PIDR2 0xFFE8
+
+#define GICD_CTLR_RWP (1u << 31)
+#define GICD_CTLR_ARE (1u << 4)
+#define GICD_CTLR_ENABLE_G1A (1u << 1)
+#define GICD_CTLR_ENABLE_G1 (1u << 0)
+
+ 
+#define GICC_CTLR 0x000
+#define GICC_PMR 0x004
+#define GICC_IAR 0x00C
+#define GICC_EOIR 0x010
 
  
-#define GICC_CTLR (GICC_BASE + 0x000)
-#define GICC_PMR (GICC_BASE + 0x004)
-#define GICC_IAR (GICC_BASE + 0x00C)
-#define GICC_EOIR (GICC_BASE + 0x010)
+#define GICR_STRIDE 0x20000
+#define GICR_SGI_OFFSET 0x10000
+#define GICR_TYPER 0x008
+#define GICR_WAKER 0x014
+#define GICR_IGROUPR0 0x080
+#define GICR_ISENABLER0 0x100
+#define GICR_IPRIORITYR 0x400
+
+#define GICR_WAKER_PROCESSOR_SLEEP (1u << 1)
+#define GICR_WAKER_CHILDREN_ASLEEP (1u << 2)
+#define GICR_TYPER_LAST (1u << 4)
+
+#define GIC_IRQ_MASK 0x3FF
+#define GIC_SPURIOUS 1023
+#define GIC_NR_SGIS 16
+#define GIC_V2_MAX_CPUS 8
 
  
 #define TIMER_IRQ 27  
 
-void gic_init(void);
+void gic_init(uint64_t hhdm);
+void gic_cpu_init(void);
+uint32_t gic_version(void);
+uint32_t gic_max_cpus(void);
 void gic_enable_irq(uint32_t irq);
 uint32_t gic_acknowledge(void);
-void gic_end_of_interrupt(uint32_t irq);
+void gic_end_of_interrupt(uint32_t iar);
+void gic_send_sgi(uint64_t cpu_mask, uint32_t sgi);
 
 #endif  
@@ -0,0 +1,96 @@
+#include "glyph.h"
+
+extern const uint8_t font_8x16[95][16];
+
+static const uint8_t custom_glyphs[8][16] = {
+    {0},
+
+    {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+     0xFF, 0xFF, 0xFF, 0xFF},
+
+    {0x36, 0x36, 0x36, 0x36, 0x36, 0x36, 0x36, 0x36, 0x36, 0x36, 0x36, 0x36,
+     0x36, 0x36, 0x36, 0x36},
+
+    {0x00, 0x00, 0x00, 0x3E, 0x36, 0x36, 0x36, 0x36, 0x36, 0x36, 0x36, 0x36,
+     0x36, 0x36, 0x36, 0x36},
+
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x63, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33,
+     0x33, 0x33, 0x33, 0x33},
+
+    {0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x63, 0x00, 0x00,
+     0x00, 0x00, 0x00, 0x00},
+
+    {0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33, 0x3F, 0x00, 0x00,
+     0x00, 0x00, 0x00, 0x00},
+
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x3F, 0x33, 0x33, 0x33, 0x33, 0x33, 0x33,
+     0x33, 0x33, 0x33, 0x33}};
+
+static uint32_t glyph_masks[GLYPH_COUNT][GLYPH_HEIGHT][GLYPH_WIDTH];
+static int glyph_masks_ready = 0;
+
+static struct glyph_atlas glyph_atlases[GLYPH_ATLAS_SLOTS];
+static uint64_t glyph_clock = 0;
+
+int glyph_index(char c) {
+  if (c >= 1 && c <= 7)
+    return GLYPH_PRINTABLE + c - 1;
+  if (c < 32 || c > 126)
+    return 0;
+  return c - 32;
+}
+
+const uint8_t *glyph_bitmap(int index) {
+  if (index >= GLYPH_PRINTABLE)
+    return custom_glyphs[index - GLYPH_PRINTABLE + 1];
+  return font_8x16[index];
+}
+
+ 
+ 
+static void glyph_build_masks(void) {
+  for (int i = 0; i < GLYPH_COUNT; i++) {
+    const uint8_t *bits = glyph_bitmap(i);
+    for (int row = 0; row < GLYPH_HEIGHT; row++) {
+      for (int col = 0; col < GLYPH_WIDTH; col++)
+        glyph_masks[i][row][col] = (bits[row] & (0x80 >> col)) ? ~0u : 0;
+    }
+  }
+  glyph_masks_ready = 1;
+}
+
+const uint32_t *glyph_mask(int index) {
+  if (!glyph_masks_ready)
+    glyph_build_masks();
+  return glyph_masks[index][0];
+}
+
+ 
+ 
+ 
+const struct glyph_atlas *glyph_atlas_get(uint32_t fg, uint32_t bg) {
+  struct glyph_atlas *victim = &glyph_atlases[0];
+  for (int i = 0; i < GLYPH_ATLAS_SLOTS; i++) {
+    struct glyph_atlas *atlas = &glyph_atlases[i];
+    if (atlas->stamp && atlas->fg == fg && atlas->bg == bg) {
+      atlas->stamp = ++glyph_clock;
+      return atlas;
+    }
+    if (atlas->stamp < victim->stamp)
+      victim = atlas;
+  }
+
+  if (!glyph_masks_ready)
+    glyph_build_masks();
+  uint32_t diff = fg ^ bg;
+  for (int i = 0; i < GLYPH_COUNT; i++) {
+    for (int row = 0; row < GLYPH_HEIGHT; row++) {
+      for (int col = 0; col < GLYPH_WIDTH; col++)
+        victim->rows[i][row][col] = bg ^ (diff & glyph_masks[i][row][col]);
+    }
+  }
+  victim->fg = fg;
+  victim->bg = bg;
+  victim->stamp = ++glyph_clock;
+  return victim;
+}
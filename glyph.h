@@ -0,0 +1,52 @@
+#ifndef GLYPH_H
+#define GLYPH_H
+
+#include <stdint.h>
+
+#define GLYPH_WIDTH 8
+#define GLYPH_HEIGHT 16
+#define GLYPH_PRINTABLE 95
+#define GLYPH_COUNT (GLYPH_PRINTABLE + 7)
+#define GLYPH_ATLAS_SLOTS 4
+
+ 
+ 
+ 
+struct glyph_atlas {
+  uint32_t fg;
+  uint32_t bg;
+  uint64_t stamp;
+  uint32_t rows[GLYPH_COUNT][GLYPH_HEIGHT][GLYPH_WIDTH];
+};
+
+ 
+ 
+int glyph_index(char c);
+const uint8_t *glyph_bitmap(int index);
+
+ 
+ 
+const uint32_t *glyph_mask(int index);
+const struct glyph_atlas *glyph_atlas_get(uint32_t fg, uint32_t bg);
+
+ 
+ 
+static inline void glyph_store_row(uint32_t *dst, const uint32_t *src) {
+  if ((uintptr_t)dst & 7) {
+    for (int i = 0; i < GLYPH_WIDTH; i++)
+      dst[i] = src[i];
+    return;
+  }
+  uint64_t a, b, c, d;
+  __builtin_memcpy(&a, src, 8);
+  __builtin_memcpy(&b, src + 2, 8);
+  __builtin_memcpy(&c, src + 4, 8);
+  __builtin_memcpy(&d, src + 6, 8);
+  uint64_t *out = (uint64_t *)dst;
+  out[0] = a;
+  out[1] = b;
+  out[2] = c;
+  out[3] = d;
+}
+
+#endif
@@ -1,8 +1,11 @@
 #include "gui.h"
 #include "compositor.h"
 #include "console.h"
+#include "heap.h"
 #include "keyboard.h"
 #include "mouse.h"
+#include "process.h"
+#include "rcu.h"
 #include "string.h"
 
 #undef COLOR_TEXT
@@ -20,6 +23,9 @@
 #define DESKTOP_ICON_GAP 20
 #define MENU_W 240
 #define MENU_H 220
+#define WINDOW_RADIUS 8
+#define SHADOW_SPREAD 6
+#define SHADOW_ALPHA 120
 
 #define COLOR_BG_TOP 0x0E1B2B
 #define COLOR_BG_BOTTOM 0x162B45
@@ -77,6 +83,20 @@ typedef struct {
   int normal_y;
   int normal_w;
   int normal_h;
+
+   
+   
+  int drawn;
+  int drawn_w;
+  int drawn_h;
+  int drawn_active;
+  int drawn_close;
+  int drawn_version;
+
+   
+   
+  int titlebar_w;
+  uint32_t *titlebar[2];
 } app_window_t;
 
 typedef struct {
@@ -84,6 +104,7 @@ typedef struct {
   int cap;
   int len;
   int cursor;
+  int version;
 } text_buffer_t;
 
 typedef struct {
@@ -121,11 +142,15 @@ static void fill_gradient_v(window_t *win, uint32_t top, uint32_t bottom) {
   }
 }
 
-static void draw_clock_to_window(window_t *win, int x, int y) {
+static int clock_minutes(void) {
   uint32_t epoch = rtc_read();
   int total_sec = epoch % 86400;
-  int hr = (total_sec / 3600 + 5) % 24;
-  int min = (total_sec / 60) % 60;
+  return ((total_sec / 3600 + 5) % 24) * 60 + (total_sec / 60) % 60;
+}
+
+static void draw_clock_to_window(window_t *win, int x, int y, int minutes) {
+  int hr = minutes / 60;
+  int min = minutes % 60;
 
   char buf[8];
   buf[0] = '0' + (hr / 10);
@@ -138,18 +163,40 @@ static void draw_clock_to_window(window_t *win, int x, int y) {
   window_draw_text(win, x, y, buf, 0xFFFFFF);
 }
 
-static void draw_window_chrome(app_window_t *app, int active,
-                               int close_hovered) {
+static void draw_close_button(window_t *win, int hovered) {
+  int close_x = win->width - 26;
+  int close_y = 6;
+  window_fill_rect(win, close_x, close_y, 18, 18,
+                   hovered ? 0xE55454 : 0xC44A4A);
+  window_draw_text(win, close_x + 5, close_y + 2, "x", 0xFFFFFF);
+}
+
+ 
+ 
+ 
+ 
+static void draw_titlebar(app_window_t *app, int active) {
   window_t *win = app->win;
-  if (!win)
+  if (app->titlebar_w != win->width) {
+    for (int i = 0; i < 2; i++) {
+      if (app->titlebar[i])
+        free(app->titlebar[i]);
+      app->titlebar[i] = NULL;
+    }
+    app->titlebar_w = win->width;
+  }
+
+  uint32_t **cached = &app->titlebar[active ? 1 : 0];
+  if (*cached) {
+    window_blit(win, 0, 0, win->width, TITLEBAR_HEIGHT, *cached);
     return;
-  window_fill_rect(win, 0, 0, win->width, win->height, COLOR_WIN_BG);
+  }
+
   window_fill_rect(win, 0, 0, win->width, TITLEBAR_HEIGHT,
                    active ? COLOR_WIN_TITLE_ACTIVE : COLOR_WIN_TITLE);
   window_draw_rect(win, 0, 0, win->width, win->height, COLOR_WIN_BORDER, 1);
   window_draw_text(win, 12, 8, app->title, 0xE6EEF9);
 
-  int close_x = win->width - 26;
   int close_y = 6;
   int max_x = win->width - 48;
   int min_x = win->width - 70;
@@ -157,9 +204,23 @@ static void draw_window_chrome(app_window_t *app, int active,
   window_draw_text(win, min_x + 5, close_y + 2, "_", 0xFFFFFF);
   window_fill_rect(win, max_x, close_y, 18, 18, 0x4A5B6E);
   window_draw_text(win, max_x + 3, close_y + 2, "[]", 0xFFFFFF);
-  uint32_t close_color = close_hovered ? 0xE55454 : 0xC44A4A;
-  window_fill_rect(win, close_x, close_y, 18, 18, close_color);
-  window_draw_text(win, close_x + 5, close_y + 2, "x", 0xFFFFFF);
+  draw_close_button(win, 0);
+
+  if (app->animating)
+    return;
+  *cached = (uint32_t *)malloc(win->width * TITLEBAR_HEIGHT * 4);
+  if (*cached)
+    window_read(win, 0, 0, win->width, TITLEBAR_HEIGHT, *cached);
+}
+
+static void free_titlebars(app_window_t *apps, int count) {
+  for (int i = 0; i < count; i++) {
+    for (int j = 0; j < 2; j++) {
+      if (apps[i].titlebar[j])
+        free(apps[i].titlebar[j]);
+      apps[i].titlebar[j] = NULL;
+    }
+  }
 }
 
 static void textbuf_init(text_buffer_t *tb, char *storage, int cap) {
@@ -167,6 +228,7 @@ static void textbuf_init(text_buffer_t *tb, char *storage, int cap) {
   tb->cap = cap;
   tb->len = 0;
   tb->cursor = 0;
+  tb->version = 0;
   if (cap > 0)
     tb->buf[0] = 0;
 }
@@ -182,6 +244,7 @@ static void textbuf_insert(text_buffer_t *tb, char c) {
   tb->buf[tb->cursor] = c;
   tb->len++;
   tb->cursor++;
+  tb->version++;
   tb->buf[tb->len] = 0;
 }
 
@@ -193,6 +256,7 @@ static void textbuf_backspace(text_buffer_t *tb) {
   }
   tb->len--;
   tb->cursor--;
+  tb->version++;
   tb->buf[tb->len] = 0;
 }
 
@@ -283,6 +347,40 @@ static void draw_app_content(app_window_t *app) {
   }
 }
 
+static void update_app_window(app_window_t *app, int active, int close_hover,
+                              text_buffer_t *tb) {
+  window_t *win = app->win;
+  int full = !app->drawn || app->drawn_w != win->width ||
+             app->drawn_h != win->height;
+  int refocus = full || app->drawn_active != active;
+
+  if (full) {
+    window_fill_rect(win, 0, 0, win->width, win->height, COLOR_WIN_BG);
+    window_draw_rect(win, 0, 0, win->width, win->height, COLOR_WIN_BORDER, 1);
+    draw_app_content(app);
+  }
+  if (refocus)
+    draw_titlebar(app, active);
+  if (refocus || app->drawn_close != close_hover)
+    draw_close_button(win, close_hover);
+
+  if (tb && (refocus || app->drawn_version != tb->version)) {
+    int area_x = 24;
+    int area_y = TITLEBAR_HEIGHT + 108;
+    int area_w = win->width - 48;
+    int area_h = win->height - area_y - 16;
+    window_fill_rect(win, area_x, area_y, area_w, area_h, COLOR_WIN_BG);
+    draw_text_area(win, tb, area_x, area_y, area_w, area_h, active);
+    app->drawn_version = tb->version;
+  }
+
+  app->drawn = 1;
+  app->drawn_w = win->width;
+  app->drawn_h = win->height;
+  app->drawn_active = active;
+  app->drawn_close = close_hover;
+}
+
 static int window_hit_test(app_window_t *app, int mx, int my) {
   window_t *win = app->win;
   if (!win || !app->visible)
@@ -336,13 +434,21 @@ static int open_btn_hit_test(app_window_t *app, int mx, int my) {
   return mx >= bx && mx < bx + 120 && my >= by && my < by + 26;
 }
 
-static void draw_taskbar(window_t *panel, int sw, int start_hovered) {
+static void draw_taskbar(window_t *panel, int sw, int start_hovered,
+                         int minutes) {
   window_fill_rect(panel, 0, 0, sw, PANEL_HEIGHT, COLOR_PANEL);
   window_fill_rect(panel, 0, 0, sw, 1, COLOR_PANEL_LINE);
   window_fill_rect(panel, 10, 7, START_BTN_SIZE, START_BTN_SIZE,
                    start_hovered ? COLOR_ACCENT_H : COLOR_ACCENT);
   window_draw_text(panel, 19, 16, "H", 0xFFFFFF);
-  draw_clock_to_window(panel, sw - 60, 16);
+  draw_clock_to_window(panel, sw - 60, 16, minutes);
+}
+
+static void draw_desktop_icon(window_t *desktop, const desktop_icon_t *icon,
+                              int hover) {
+  window_fill_rect(desktop, icon->x, icon->y, DESKTOP_ICON_W, DESKTOP_ICON_H,
+                   hover ? COLOR_ACCENT_DIM : 0x223247);
+  window_draw_text(desktop, icon->x + 8, icon->y + 20, "[]", 0xFFFFFF);
 }
 
 static void draw_start_menu(window_t *menu) {
@@ -359,6 +465,7 @@ static void draw_start_menu(window_t *menu) {
 
 void gui_desktop_run(void) {
   compositor_init();
+  compositor_start();
   int sw = compositor_get_width();
   int sh = compositor_get_height();
 
@@ -378,6 +485,7 @@ void gui_desktop_run(void) {
                                MENU_H, 900);
   menu->alpha = 245;
   menu->visible = 0;
+  draw_start_menu(menu);
 
   app_window_t apps[4];
   k_memset(apps, 0, sizeof(apps));
@@ -385,9 +493,8 @@ void gui_desktop_run(void) {
   apps[0].title = "Terminal";
   apps[0].win = compositor_create_window(140, 140, 420, 280, 10);
   apps[0].shadow = compositor_create_window(134, 136, 432, 292, 9);
-  apps[0].shadow->alpha = 120;
-  window_fill_rect(apps[0].shadow, 0, 0, apps[0].shadow->width,
-                   apps[0].shadow->height, 0x000000);
+  window_draw_shadow(apps[0].shadow, SHADOW_SPREAD, SHADOW_ALPHA);
+  window_set_corner_radius(apps[0].win, WINDOW_RADIUS);
   apps[0].visible = 0;
   apps[0].normal_x = apps[0].win->x;
   apps[0].normal_y = apps[0].win->y;
@@ -398,9 +505,8 @@ void gui_desktop_run(void) {
   apps[1].title = "Donut Demo";
   apps[1].win = compositor_create_window(180, 180, 420, 260, 11);
   apps[1].shadow = compositor_create_window(174, 176, 432, 272, 10);
-  apps[1].shadow->alpha = 120;
-  window_fill_rect(apps[1].shadow, 0, 0, apps[1].shadow->width,
-                   apps[1].shadow->height, 0x000000);
+  window_draw_shadow(apps[1].shadow, SHADOW_SPREAD, SHADOW_ALPHA);
+  window_set_corner_radius(apps[1].win, WINDOW_RADIUS);
   apps[1].visible = 0;
   apps[1].normal_x = apps[1].win->x;
   apps[1].normal_y = apps[1].win->y;
@@ -411,9 +517,8 @@ void gui_desktop_run(void) {
   apps[2].title = "Editor";
   apps[2].win = compositor_create_window(220, 160, 460, 300, 12);
   apps[2].shadow = compositor_create_window(214, 156, 472, 312, 11);
-  apps[2].shadow->alpha = 120;
-  window_fill_rect(apps[2].shadow, 0, 0, apps[2].shadow->width,
-                   apps[2].shadow->height, 0x000000);
+  window_draw_shadow(apps[2].shadow, SHADOW_SPREAD, SHADOW_ALPHA);
+  window_set_corner_radius(apps[2].win, WINDOW_RADIUS);
   apps[2].visible = 0;
   apps[2].normal_x = apps[2].win->x;
   apps[2].normal_y = apps[2].win->y;
@@ -426,9 +531,8 @@ void gui_desktop_run(void) {
       compositor_create_window(sw / 2 - 170, sh / 2 - 140, 340, 220, 13);
   apps[3].shadow =
       compositor_create_window(sw / 2 - 176, sh / 2 - 144, 352, 232, 12);
-  apps[3].shadow->alpha = 120;
-  window_fill_rect(apps[3].shadow, 0, 0, apps[3].shadow->width,
-                   apps[3].shadow->height, 0x000000);
+  window_draw_shadow(apps[3].shadow, SHADOW_SPREAD, SHADOW_ALPHA);
+  window_set_corner_radius(apps[3].win, WINDOW_RADIUS);
   apps[3].visible = 1;
   apps[3].normal_x = apps[3].win->x;
   apps[3].normal_y = apps[3].win->y;
@@ -442,6 +546,16 @@ void gui_desktop_run(void) {
       {30, 40 + (DESKTOP_ICON_H + DESKTOP_ICON_GAP) * 3, "About", APP_ABOUT},
   };
 
+  int icon_count = (int)(sizeof(icons) / sizeof(icons[0]));
+  fill_gradient_v(desktop, COLOR_BG_TOP, COLOR_BG_BOTTOM);
+  for (int i = 0; i < icon_count; i++) {
+    draw_desktop_icon(desktop, &icons[i], 0);
+    window_draw_text(desktop, icons[i].x - 2, icons[i].y + 62, icons[i].label,
+                     0xFFFFFF);
+  }
+  int drawn_icon = -1;
+  uint32_t drawn_panel = 0xFFFFFFFF;
+
   int running = 1;
   int prev_sec = -1;
   int was_click = 0;
@@ -454,6 +568,8 @@ void gui_desktop_run(void) {
   int task_btn_y = sh - PANEL_HEIGHT + 10;
 
   while (running) {
+    rcu_quiescent_state();
+    cond_resched();
     mouse_poll();
     int mx = mouse_get_x();
     int my = mouse_get_y();
@@ -711,17 +827,20 @@ void gui_desktop_run(void) {
       }
     }
 
-    fill_gradient_v(desktop, COLOR_BG_TOP, COLOR_BG_BOTTOM);
-    int icon_count = (int)(sizeof(icons) / sizeof(icons[0]));
+    int hover_icon = -1;
     for (int i = 0; i < icon_count; i++) {
       int ix = icons[i].x;
       int iy = icons[i].y;
-      int hover = mx >= ix && mx < ix + DESKTOP_ICON_W && my >= iy &&
-                  my < iy + DESKTOP_ICON_H;
-      window_fill_rect(desktop, ix, iy, DESKTOP_ICON_W, DESKTOP_ICON_H,
-                       hover ? COLOR_ACCENT_DIM : 0x223247);
-      window_draw_text(desktop, ix + 8, iy + 20, "[]", 0xFFFFFF);
-      window_draw_text(desktop, ix - 2, iy + 62, icons[i].label, 0xFFFFFF);
+      if (mx >= ix && mx < ix + DESKTOP_ICON_W && my >= iy &&
+          my < iy + DESKTOP_ICON_H)
+        hover_icon = i;
+    }
+    if (hover_icon != drawn_icon) {
+      if (drawn_icon >= 0)
+        draw_desktop_icon(desktop, &icons[drawn_icon], 0);
+      if (hover_icon >= 0)
+        draw_desktop_icon(desktop, &icons[hover_icon], 1);
+      drawn_icon = hover_icon;
     }
 
     for (int i = 0; i < 4; i++) {
@@ -730,65 +849,68 @@ void gui_desktop_run(void) {
       apps[i].win->visible = apps[i].visible;
       if (apps[i].shadow) {
         apps[i].shadow->visible = apps[i].visible;
-        apps[i].shadow->x = apps[i].win->x - 6;
+        apps[i].shadow->x = apps[i].win->x - SHADOW_SPREAD;
         apps[i].shadow->y = apps[i].win->y - 4;
-        window_resize(apps[i].shadow, apps[i].win->width + 12,
-                      apps[i].win->height + 12);
-        window_fill_rect(apps[i].shadow, 0, 0, apps[i].shadow->width,
-                         apps[i].shadow->height, 0x000000);
+        int shadow_w = apps[i].win->width + SHADOW_SPREAD * 2;
+        int shadow_h = apps[i].win->height + SHADOW_SPREAD * 2;
+        if (apps[i].shadow->width != shadow_w ||
+            apps[i].shadow->height != shadow_h) {
+          window_resize(apps[i].shadow, shadow_w, shadow_h);
+          window_draw_shadow(apps[i].shadow, SHADOW_SPREAD, SHADOW_ALPHA);
+        }
       }
       if (!apps[i].visible)
         continue;
       int close_hover =
           close_hit_test(&apps[i], mx, my);
       int active = (active_app == &apps[i]);
-      draw_window_chrome(&apps[i], active, close_hover);
-      draw_app_content(&apps[i]);
-
-      if (apps[i].id == APP_TERMINAL) {
-        int area_x = 24;
-        int area_y = TITLEBAR_HEIGHT + 108;
-        int area_w = apps[i].win->width - 48;
-        int area_h = apps[i].win->height - area_y - 16;
-        draw_text_area(apps[i].win, &terminal_buf, area_x, area_y, area_w,
-                       area_h, active);
-      } else if (apps[i].id == APP_EDITOR) {
-        int area_x = 24;
-        int area_y = TITLEBAR_HEIGHT + 108;
-        int area_w = apps[i].win->width - 48;
-        int area_h = apps[i].win->height - area_y - 16;
-        draw_text_area(apps[i].win, &editor_buf, area_x, area_y, area_w,
-                       area_h, active);
-      }
+      text_buffer_t *tb = NULL;
+      if (apps[i].id == APP_TERMINAL)
+        tb = &terminal_buf;
+      else if (apps[i].id == APP_EDITOR)
+        tb = &editor_buf;
+      update_app_window(&apps[i], active, close_hover, tb);
     }
 
-    draw_taskbar(panel, sw, start_hovered);
-    int tbx = 10 + START_BTN_SIZE + 16;
+     
+     
+    int minutes = clock_minutes();
+    uint32_t panel_state = (uint32_t)start_hovered | (uint32_t)minutes << 1;
     for (int i = 0; i < 4; i++) {
-      if (!apps[i].win)
-        continue;
-      int by = 10;
-      uint32_t btn_color = (active_app == &apps[i] && apps[i].visible)
-                               ? COLOR_ACCENT
-                               : COLOR_PANEL_LINE;
-      window_fill_rect(panel, tbx, by, TASK_BTN_W, TASK_BTN_H, btn_color);
-      window_draw_text(panel, tbx + 8, by + 6, apps[i].title,
-                       COLOR_PANEL_TEXT);
-      if (!apps[i].visible && (apps[i].minimized || apps[i].opened)) {
-        window_fill_rect(panel, tbx + 8, by + TASK_BTN_H - 4, 24, 2,
-                         COLOR_ACCENT_H);
+      int lit = active_app == &apps[i] && apps[i].visible;
+      int marked = !apps[i].visible && (apps[i].minimized || apps[i].opened);
+      panel_state |= (uint32_t)(lit | marked << 1) << (12 + i * 2);
+    }
+    if (panel_state != drawn_panel) {
+      drawn_panel = panel_state;
+      draw_taskbar(panel, sw, start_hovered, minutes);
+      int tbx = 10 + START_BTN_SIZE + 16;
+      for (int i = 0; i < 4; i++) {
+        if (!apps[i].win)
+          continue;
+        int by = 10;
+        uint32_t btn_color = (active_app == &apps[i] && apps[i].visible)
+                                 ? COLOR_ACCENT
+                                 : COLOR_PANEL_LINE;
+        window_fill_rect(panel, tbx, by, TASK_BTN_W, TASK_BTN_H, btn_color);
+        window_draw_text(panel, tbx + 8, by + 6, apps[i].title,
+                         COLOR_PANEL_TEXT);
+        if (!apps[i].visible && (apps[i].minimized || apps[i].opened)) {
+          window_fill_rect(panel, tbx + 8, by + TASK_BTN_H - 4, 24, 2,
+                           COLOR_ACCENT_H);
+        }
+        tbx += TASK_BTN_W + 10;
       }
-      tbx += TASK_BTN_W + 10;
     }
 
     menu->visible = menu->visible ? 1 : 0;
-    if (menu->visible) {
-      draw_start_menu(menu);
-    }
 
-    compositor_render(mx, my);
+    compositor_commit(mx, my);
+    compositor_wait_frame();
 
     if (launch_app_id != 0) {
+      free_titlebars(apps, 4);
+      compositor_shutdown();
       console_clear();
       if (launch_app_id == APP_TERMINAL) {
         return;
@@ -841,5 +963,7 @@ void gui_desktop_run(void) {
       compositor_destroy_window(apps[i].shadow);
     compositor_destroy_window(apps[i].win);
   }
+  free_titlebars(apps, 4);
+  compositor_shutdown();
   console_clear();
 }
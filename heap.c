@@ -1,6 +1,6 @@
 #include "heap.h"
-#include "console.h"
 #include "pmm.h"
+#include "printk.h"
 
 struct block_header {
   size_t size;
@@ -18,7 +18,7 @@ void heap_init(void) {
   head->is_free = 1;
   head->next = NULL;
 
-  console_print("HEAP: Initialized (1MB Static).\n");
+  printk(PRINTK_INFO, "HEAP: Initialized (1MB Static).\n");
 }
 
 void *malloc(size_t size) {
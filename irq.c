@@ -1,17 +1,186 @@
+#include "irq.h"
 #include "console.h"
 #include "gic.h"
-#include "process.h"
+#include "smp.h"
+#include "softirq.h"
+#include "timer.h"
+#include <stddef.h>
 
- 
-extern void timer_reload(void);
+#define IRQ_BENCH_SGI 15
+#define IRQ_BENCH_TIMEOUT 100000000
+
+struct irq_desc {
+  irq_handler_t handler;
+  void *ctx;
+  uint64_t count;
+  uint64_t ticks;
+  uint64_t max_ticks;
+  uint32_t hist[IRQ_HIST_BUCKETS];
+};
+
+extern char vectors[];
+
+static struct irq_desc irq_descs[NR_IRQS];
+static uint64_t irq_unhandled;
+
+static volatile uint64_t irq_bench_stamp;
+static uint32_t irq_bench_hits;
+
+void irq_cpu_init(void) {
+  __asm__ volatile("msr vbar_el1, %0\n"
+                   "isb" ::"r"(vectors)
+                   : "memory");
+  gic_cpu_init();
+}
+
+static void irq_bench_handler(uint32_t irq, void *ctx) {
+  (void)irq;
+  (void)ctx;
+  irq_bench_stamp = timer_read_counter();
+  __atomic_fetch_add(&irq_bench_hits, 1, __ATOMIC_RELEASE);
+}
+
+void irq_init(uint64_t hhdm) {
+  __asm__ volatile("mov x9, sp\n"
+                   "msr spsel, #1\n"
+                   "mov sp, x9" ::
+                       : "x9", "memory");
+
+  gic_init(hhdm);
+  irq_cpu_init();
+  irq_register(IRQ_BENCH_SGI, irq_bench_handler, NULL);
+  local_irq_enable();
+}
+
+int irq_register(uint32_t irq, irq_handler_t handler, void *ctx) {
+  if (irq >= NR_IRQS || !handler)
+    return -1;
+
+  struct irq_desc *desc = &irq_descs[irq];
+  if (desc->handler)
+    return -1;
+
+  desc->ctx = ctx;
+  __atomic_store_n(&desc->handler, handler, __ATOMIC_RELEASE);
+
+  if (irq >= GIC_NR_SGIS)
+    gic_enable_irq(irq);
+  return 0;
+}
+
+static void irq_account(struct irq_desc *desc, uint64_t ticks) {
+  uint32_t bucket = ticks ? 64 - __builtin_clzll(ticks) : 0;
+  if (bucket >= IRQ_HIST_BUCKETS)
+    bucket = IRQ_HIST_BUCKETS - 1;
+
+  __atomic_fetch_add(&desc->count, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&desc->ticks, ticks, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&desc->hist[bucket], 1, __ATOMIC_RELAXED);
+  if (ticks > desc->max_ticks)
+    desc->max_ticks = ticks;
+}
 
  
 void irq_handler(void) {
-  uint32_t irq = gic_acknowledge();
+  uint64_t start = timer_read_counter();
+  uint32_t iar = gic_acknowledge();
+  uint32_t irq = iar & GIC_IRQ_MASK;
 
-   
-   
+  if (irq >= NR_IRQS) {
+    if (irq < 1020) {
+      __atomic_fetch_add(&irq_unhandled, 1, __ATOMIC_RELAXED);
+      gic_end_of_interrupt(iar);
+    }
+    return;
+  }
+
+  struct irq_desc *desc = &irq_descs[irq];
+  irq_handler_t handler = __atomic_load_n(&desc->handler, __ATOMIC_ACQUIRE);
+  if (handler)
+    handler(irq, desc->ctx);
+  else
+    __atomic_fetch_add(&irq_unhandled, 1, __ATOMIC_RELAXED);
 
    
-  gic_end_of_interrupt(irq);
+  gic_end_of_interrupt(iar);
+  irq_account(desc, timer_read_counter() - start);
+
+  do_softirq();
+}
+
+void irq_print_stats(void) {
+  console_print("IRQ   COUNT       AVG(ns)   MAX(ns)\n");
+  for (uint32_t irq = 0; irq < NR_IRQS; irq++) {
+    struct irq_desc *desc = &irq_descs[irq];
+    uint64_t count = __atomic_load_n(&desc->count, __ATOMIC_RELAXED);
+    if (!count)
+      continue;
+
+    console_print_dec(irq);
+    console_print("    ");
+    console_print_dec(count);
+    console_print("    ");
+    console_print_dec(timer_ticks_to_ns(desc->ticks / count));
+    console_print("    ");
+    console_print_dec(timer_ticks_to_ns(desc->max_ticks));
+    console_print("\n     ");
+
+    for (uint32_t b = 0; b < IRQ_HIST_BUCKETS; b++) {
+      if (!desc->hist[b])
+        continue;
+      console_print(" <");
+      console_print_dec(timer_ticks_to_ns(1ull << b));
+      console_print("ns:");
+      console_print_dec(desc->hist[b]);
+    }
+    console_print("\n");
+  }
+  console_print("Unhandled: ");
+  console_print_dec(irq_unhandled);
+  console_print("\n");
+}
+
+void irq_benchmark(uint32_t iterations) {
+  uint64_t daif;
+  __asm__ volatile("mrs %0, daif" : "=r"(daif));
+  if (daif & (1 << 7)) {
+    console_print("IRQ: Interrupts are masked.\n");
+    return;
+  }
+
+  uint64_t self = 1ull << smp_processor_id();
+  uint64_t entry = 0, exit = 0, done = 0;
+
+  for (uint32_t i = 0; i < iterations; i++) {
+    uint32_t hits = __atomic_load_n(&irq_bench_hits, __ATOMIC_ACQUIRE);
+    uint64_t t0 = timer_read_counter();
+    gic_send_sgi(self, IRQ_BENCH_SGI);
+
+    uint64_t t;
+    for (t = 0; t < IRQ_BENCH_TIMEOUT; t++) {
+      if (__atomic_load_n(&irq_bench_hits, __ATOMIC_ACQUIRE) != hits)
+        break;
+    }
+    uint64_t t1 = timer_read_counter();
+    if (t == IRQ_BENCH_TIMEOUT) {
+      console_print("IRQ: Benchmark SGI was never taken.\n");
+      return;
+    }
+
+    entry += irq_bench_stamp - t0;
+    exit += t1 - irq_bench_stamp;
+    done++;
+  }
+  if (!done)
+    return;
+
+  console_print("IRQ: ");
+  console_print_dec(done);
+  console_print(" self-SGIs, entry ");
+  console_print_dec(timer_ticks_to_ns(entry) / done);
+  console_print("ns, exit ");
+  console_print_dec(timer_ticks_to_ns(exit) / done);
+  console_print("ns (timer ");
+  console_print_dec(timer_frequency() / 1000000);
+  console_print(" MHz)\n");
 }
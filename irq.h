@@ -0,0 +1,39 @@
+#ifndef IRQ_H
+#define IRQ_H
+
+#include <stdint.h>
+
+#define NR_IRQS 256
+#define IRQ_HIST_BUCKETS 16
+
+typedef void (*irq_handler_t)(uint32_t irq, void *ctx);
+
+void irq_init(uint64_t hhdm);
+void irq_cpu_init(void);
+int irq_register(uint32_t irq, irq_handler_t handler, void *ctx);
+void irq_print_stats(void);
+void irq_benchmark(uint32_t iterations);
+
+static inline void local_irq_enable(void) {
+  __asm__ volatile("msr daifclr, #2" ::: "memory");
+}
+
+static inline void local_irq_disable(void) {
+  __asm__ volatile("msr daifset, #2" ::: "memory");
+}
+
+static inline uint64_t local_irq_save(void) {
+  uint64_t flags;
+  __asm__ volatile("mrs %0, daif\n"
+                   "msr daifset, #2"
+                   : "=r"(flags)
+                   :
+                   : "memory");
+  return flags;
+}
+
+static inline void local_irq_restore(uint64_t flags) {
+  __asm__ volatile("msr daif, %0" ::"r"(flags) : "memory");
+}
+
+#endif
@@ -1,17 +1,27 @@
+#include "blend.h"
+#include "bootprof.h"
 #include "console.h"
+#include "crash.h"
+#include "display.h"
 #include "gic.h"
 #include "gui.h"
 #include "heap.h"
+#include "irq.h"
 #include "keyboard.h"
 #include "limine.h"
 #include "mouse.h"
 #include "pmm.h"
+#include "printk.h"
 #include "process.h"
+#include "rcu.h"
 #include "shell.h"
+#include "smp.h"
+#include "softirq.h"
 #include "timer.h"
 #include "tmpfs.h"
 #include "uart.h"
 #include "vfs.h"
+#include "workqueue.h"
 #include <stddef.h>
 #include <stdint.h>
 
@@ -54,12 +64,16 @@ static void hcf(void) {
 }
 
 void _start(void) {
+  bootprof_start();
+  smp_set_processor_id(0);
+  fpsimd_enable();
 
   uint64_t uart_vbase = UART0_PHYS;
   if (hhdm_request.response != NULL) {
     uart_vbase += hhdm_request.response->offset;
   }
   uart_init(uart_vbase);
+  bootprof_mark("uart_init");
 
   if (framebuffer_request.response != NULL &&
       framebuffer_request.response->framebuffer_count > 0) {
@@ -67,6 +81,17 @@ void _start(void) {
         framebuffer_request.response->framebuffers[0];
     console_init(fb);
   }
+  bootprof_mark("console_init");
+
+  softirq_init();
+  bootprof_mark("softirq_init");
+
+  if (hhdm_request.response != NULL) {
+    irq_init(hhdm_request.response->offset);
+    bootprof_mark("irq_init");
+    uart_irq_init();
+    bootprof_mark("uart_irq_init");
+  }
 
   if (hhdm_request.response != NULL &&
       kernel_address_request.response != NULL) {
@@ -74,27 +99,53 @@ void _start(void) {
     uint64_t vbase = kernel_address_request.response->virtual_base;
     uint64_t pbase = kernel_address_request.response->physical_base;
     keyboard_init(hhdm, vbase, pbase);
+    bootprof_mark("keyboard_init");
     mouse_init(hhdm, vbase, pbase);
+    bootprof_mark("mouse_init");
     gui_set_hhdm(hhdm);
+    display_init(hhdm, vbase, pbase);
+    bootprof_mark("display_init");
   }
 
   if (memmap_request.response != NULL && hhdm_request.response != NULL) {
+    crash_init(memmap_request.response, hhdm_request.response->offset);
+    bootprof_mark("crash_init");
     pmm_init(memmap_request.response, hhdm_request.response->offset);
+    bootprof_mark("pmm_init");
   } else {
     console_print("KERNEL PANIC: No Memory Map or HHDM!\n");
     hcf();
   }
 
   heap_init();
+  bootprof_mark("heap_init");
+
+  rcu_init();
+  bootprof_mark("rcu_init");
 
   process_init();
+  bootprof_mark("process_init");
+
+  workqueue_init();
+  bootprof_mark("workqueue_init");
+
+  printk_start();
+  bootprof_mark("printk_start");
+
+  smp_init();
+  bootprof_mark("smp_init");
 
   fs_root = tmpfs_init();
   if (fs_root) {
-    console_print("VFS: TmpFS mounted at /\n");
+    printk(PRINTK_INFO, "VFS: TmpFS mounted at /\n");
   } else {
-    console_print("VFS: Failed to mount TmpFS!\n");
+    printk(PRINTK_ERR, "VFS: Failed to mount TmpFS!\n");
   }
+  bootprof_mark("tmpfs_init");
+
+  printk_flush();
+  bootprof_mark("printk_flush");
+  bootprof_print();
 
   shell_run();
 
@@ -1,15 +1,12 @@
 #include "keyboard.h"
+#include "irq.h"
+#include "process.h"
+#include "softirq.h"
 #include "uart.h"
 #include "virtio.h"
 #include <stddef.h>
 #include <stdint.h>
 
-struct virtio_input_event {
-  uint16_t type;
-  uint16_t code;
-  uint32_t value;
-};
-
 #define QUEUE_SIZE 8
 #define PAGE_SIZE 4096
 
@@ -39,6 +36,12 @@ static volatile struct vq_avail_fixed *avail_ptr;
 static volatile struct vq_used_fixed *used_ptr;
 
 static uint64_t kbd_base = 0;
+static uint32_t kbd_irq = 0;
+static struct virtio_input_queue kbd_queue;
+static struct tasklet kbd_tasklet;
+
+static void keyboard_interrupt(uint32_t irq, void *ctx);
+static void keyboard_drain(void *data);
 
 static uint64_t to_phys(void *vaddr, uint64_t vbase, uint64_t pbase) {
   return (uint64_t)vaddr - vbase + pbase;
@@ -121,9 +124,68 @@ int keyboard_init(uint64_t hhdm_offset, uint64_t kernel_vbase,
 
   *(volatile uint32_t *)(kbd_base + VIRTIO_MMIO_QUEUE_NOTIFY) = 0;
 
+  tasklet_init(&kbd_tasklet, keyboard_drain, NULL);
+  kbd_irq = virtio_mmio_irq(kbd_base, hhdm_offset);
+  irq_register(kbd_irq, keyboard_interrupt, NULL);
+
   return 0;
 }
 
+static void keyboard_interrupt(uint32_t irq, void *ctx) {
+  (void)irq;
+  (void)ctx;
+  if (!kbd_base)
+    return;
+
+  uint32_t status =
+      *(volatile uint32_t *)(kbd_base + VIRTIO_MMIO_INTERRUPT_STATUS);
+  *(volatile uint32_t *)(kbd_base + VIRTIO_MMIO_INTERRUPT_ACK) = status;
+  __asm__ volatile("dmb sy" ::: "memory");
+
+  tasklet_schedule(&kbd_tasklet);
+}
+
+static void keyboard_drain(void *data) {
+  (void)data;
+
+  __asm__ volatile("dc ivac, %0" ::"r"(&used_ptr->idx) : "memory");
+  __asm__ volatile("dmb sy" ::: "memory");
+
+  int recycled = 0;
+  while (used_ptr->idx != last_used_idx) {
+    uint16_t head = last_used_idx % QUEUE_SIZE;
+
+    __asm__ volatile("dc ivac, %0" ::"r"(&used_ptr->ring[head]) : "memory");
+    __asm__ volatile("dmb sy" ::: "memory");
+
+    uint32_t id = used_ptr->ring[head].id;
+    volatile struct virtio_input_event *evt = &events[id];
+
+    __asm__ volatile("dc ivac, %0" ::"r"(evt) : "memory");
+    __asm__ volatile("dmb sy" ::: "memory");
+
+    if (evt->type == 1 && evt->value == 1) {
+      virtio_input_queue_push(&kbd_queue, evt);
+    }
+
+    avail_ptr->ring[avail_ptr->idx % QUEUE_SIZE] = id;
+    avail_ptr->idx++;
+
+    __asm__ volatile(
+        "dc civac, %0" ::"r"(&avail_ptr->ring[avail_ptr->idx % QUEUE_SIZE])
+        : "memory");
+    __asm__ volatile("dc civac, %0" ::"r"(&avail_ptr->idx) : "memory");
+
+    last_used_idx++;
+    recycled = 1;
+  }
+
+  if (recycled) {
+    __asm__ volatile("dmb sy" ::: "memory");
+    *(volatile uint32_t *)(kbd_base + VIRTIO_MMIO_QUEUE_NOTIFY) = 0;
+  }
+}
+
 static int ev_to_key(uint16_t code) {
   if (code == 28)
     return '\n';
@@ -176,48 +238,19 @@ static int ev_to_key(uint16_t code) {
 int keyboard_has_char(void) {
   if (!kbd_base)
     return 0;
-
-  __asm__ volatile("dc ivac, %0" ::"r"(&used_ptr->idx) : "memory");
-  __asm__ volatile("dmb sy" ::: "memory");
-
-  return (used_ptr->idx != last_used_idx);
+  return !virtio_input_queue_empty(&kbd_queue);
 }
 
 int keyboard_getc(void) {
-  while (!keyboard_has_char()) {
-    __asm__ volatile("yield");
+  struct virtio_input_event evt;
+  for (;;) {
+    local_irq_disable();
+    if (virtio_input_queue_pop(&kbd_queue, &evt))
+      break;
+    __asm__ volatile("wfi");
+    local_irq_enable();
+    cond_resched();
   }
-
-  uint16_t head = last_used_idx % QUEUE_SIZE;
-
-  __asm__ volatile("dc ivac, %0" ::"r"(&used_ptr->ring[head]) : "memory");
-  __asm__ volatile("dmb sy" ::: "memory");
-
-  struct virtq_used_elem *e = (struct virtq_used_elem *)&used_ptr->ring[head];
-  struct virtio_input_event *evt = &events[e->id];
-
-  __asm__ volatile("dc ivac, %0" ::"r"(evt) : "memory");
-  __asm__ volatile("dmb sy" ::: "memory");
-
-  int c = 0;
-  if (evt->type == 1 && evt->value == 1) {
-    c = ev_to_key(evt->code);
-  }
-
-  avail_ptr->ring[avail_ptr->idx % QUEUE_SIZE] = e->id;
-  avail_ptr->idx++;
-
-  __asm__ volatile(
-      "dc civac, %0" ::"r"(&avail_ptr->ring[avail_ptr->idx % QUEUE_SIZE])
-      : "memory");
-  __asm__ volatile("dc civac, %0" ::"r"(&avail_ptr->idx) : "memory");
-  __asm__ volatile("dmb sy" ::: "memory");
-
-  *(volatile uint32_t *)(kbd_base + VIRTIO_MMIO_QUEUE_NOTIFY) = 0;
-
-  *(volatile uint32_t *)(kbd_base + VIRTIO_MMIO_QUEUE_NOTIFY) = 0;
-
-  last_used_idx++;
-
-  return c;
+  local_irq_enable();
+  return ev_to_key(evt.code);
 }
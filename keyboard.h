@@ -13,6 +13,7 @@ int keyboard_init(uint64_t hhdm_offset, uint64_t kernel_vbase,
  
 int keyboard_has_char(void);
 
+
  
  
 int keyboard_getc(void);
@@ -1,14 +1,10 @@
 #include "mouse.h"
+#include "irq.h"
+#include "softirq.h"
 #include "virtio.h"
 #include <stddef.h>
 #include <stdint.h>
 
-struct virtio_input_event {
-  uint16_t type;
-  uint16_t code;
-  uint32_t value;
-};
-
 #define QUEUE_SIZE 8
 #define PAGE_SIZE 4096
 
@@ -37,6 +33,9 @@ static volatile struct vq_avail_fixed *avail_ptr;
 static volatile struct vq_used_fixed *used_ptr;
 
 static uint64_t mouse_base = 0;
+static uint32_t mouse_irq = 0;
+static struct virtio_input_queue mouse_queue;
+static struct tasklet mouse_tasklet;
 
 static int mouse_x = 0;
 static int mouse_y = 0;
@@ -44,6 +43,9 @@ static int mouse_buttons = 0;
 static int screen_width = 1024;
 static int screen_height = 768;
 
+static void mouse_interrupt(uint32_t irq, void *ctx);
+static void mouse_drain(void *data);
+
 static uint64_t to_phys(void *vaddr, uint64_t vbase, uint64_t pbase) {
   return (uint64_t)vaddr - vbase + pbase;
 }
@@ -135,65 +137,95 @@ int mouse_init(uint64_t hhdm_offset, uint64_t kernel_vbase,
   mouse_x = screen_width / 2;
   mouse_y = screen_height / 2;
 
+  tasklet_init(&mouse_tasklet, mouse_drain, NULL);
+  mouse_irq = virtio_mmio_irq(mouse_base, hhdm_offset);
+  irq_register(mouse_irq, mouse_interrupt, NULL);
+
   return 0;
 }
 
-void mouse_poll(void) {
+static void mouse_interrupt(uint32_t irq, void *ctx) {
+  (void)irq;
+  (void)ctx;
   if (!mouse_base)
     return;
 
+  uint32_t status =
+      *(volatile uint32_t *)(mouse_base + VIRTIO_MMIO_INTERRUPT_STATUS);
+  *(volatile uint32_t *)(mouse_base + VIRTIO_MMIO_INTERRUPT_ACK) = status;
+  __asm__ volatile("dmb sy" ::: "memory");
+
+  tasklet_schedule(&mouse_tasklet);
+}
+
+static void mouse_drain(void *data) {
+  (void)data;
+
   __asm__ volatile("dc ivac, %0" ::"r"(&used_ptr->idx) : "memory");
   __asm__ volatile("dmb sy" ::: "memory");
 
+  int recycled = 0;
   while (used_ptr->idx != last_used_idx) {
     uint16_t head = last_used_idx % QUEUE_SIZE;
 
     __asm__ volatile("dc ivac, %0" ::"r"(&used_ptr->ring[head]) : "memory");
     __asm__ volatile("dmb sy" ::: "memory");
 
-    struct virtq_used_elem *e = (struct virtq_used_elem *)&used_ptr->ring[head];
-    struct virtio_input_event *evt = &events[e->id];
+    uint32_t id = used_ptr->ring[head].id;
+    volatile struct virtio_input_event *evt = &events[id];
 
     __asm__ volatile("dc ivac, %0" ::"r"(evt) : "memory");
     __asm__ volatile("dmb sy" ::: "memory");
 
-    if (evt->type == 3) {
-      if (evt->code == 0) {
-        mouse_x = (evt->value * screen_width) / 32768;
-      } else if (evt->code == 1) {
-        mouse_y = (evt->value * screen_height) / 32768;
+    if (evt->type == 1 || evt->type == 3) {
+      virtio_input_queue_push(&mouse_queue, evt);
+    }
+
+    avail_ptr->ring[avail_ptr->idx % QUEUE_SIZE] = id;
+    avail_ptr->idx++;
+
+    __asm__ volatile(
+        "dc civac, %0" ::"r"(&avail_ptr->ring[avail_ptr->idx % QUEUE_SIZE])
+        : "memory");
+    __asm__ volatile("dc civac, %0" ::"r"(&avail_ptr->idx) : "memory");
+
+    last_used_idx++;
+    recycled = 1;
+  }
+
+  if (recycled) {
+    __asm__ volatile("dmb sy" ::: "memory");
+    *(volatile uint32_t *)(mouse_base + VIRTIO_MMIO_QUEUE_NOTIFY) = 0;
+  }
+}
+
+void mouse_poll(void) {
+  struct virtio_input_event evt;
+  while (virtio_input_queue_pop(&mouse_queue, &evt)) {
+    if (evt.type == 3) {
+      if (evt.code == 0) {
+        mouse_x = (evt.value * screen_width) / 32768;
+      } else if (evt.code == 1) {
+        mouse_y = (evt.value * screen_height) / 32768;
       }
-    } else if (evt->type == 1) {
-      if (evt->code == 0x110) {
-        if (evt->value)
+    } else if (evt.type == 1) {
+      if (evt.code == 0x110) {
+        if (evt.value)
           mouse_buttons |= MOUSE_BTN_LEFT;
         else
           mouse_buttons &= ~MOUSE_BTN_LEFT;
-      } else if (evt->code == 0x111) {
-        if (evt->value)
+      } else if (evt.code == 0x111) {
+        if (evt.value)
           mouse_buttons |= MOUSE_BTN_RIGHT;
         else
           mouse_buttons &= ~MOUSE_BTN_RIGHT;
-      } else if (evt->code == 0x112) {
-        if (evt->value)
+      } else if (evt.code == 0x112) {
+        if (evt.value)
           mouse_buttons |= MOUSE_BTN_MIDDLE;
         else
           mouse_buttons &= ~MOUSE_BTN_MIDDLE;
       }
     }
-
-    avail_ptr->ring[avail_ptr->idx % QUEUE_SIZE] = e->id;
-    avail_ptr->idx++;
-
-    __asm__ volatile(
-        "dc civac, %0" ::"r"(&avail_ptr->ring[avail_ptr->idx % QUEUE_SIZE])
-        : "memory");
-    __asm__ volatile("dc civac, %0" ::"r"(&avail_ptr->idx) : "memory");
-    __asm__ volatile("dmb sy" ::: "memory");
-
-    *(volatile uint32_t *)(mouse_base + VIRTIO_MMIO_QUEUE_NOTIFY) = 0;
-
-    last_used_idx++;
   }
 }
 
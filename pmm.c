@@ -1,6 +1,6 @@
 #include "pmm.h"
-#include "console.h"
 #include "limine.h"
+#include "printk.h"
 #include <stddef.h>
 
 static uint64_t total_memory = 0;
@@ -9,22 +9,48 @@ static uint64_t hhdm_offset = 0;
 static void *free_list = NULL;
 
 #define PAGE_SIZE 4096
+#define PMM_MAX_RESERVED 4
+
+struct pmm_range {
+  uint64_t base;
+  uint64_t end;
+};
+
+static struct pmm_range reserved[PMM_MAX_RESERVED];
+static int reserved_count = 0;
 
  
 struct free_page {
   struct free_page *next;
 };
 
+void pmm_reserve(uint64_t base, uint64_t length) {
+  if (reserved_count >= PMM_MAX_RESERVED) {
+    printk(PRINTK_WARN, "PMM: Too many reserved ranges\n");
+    return;
+  }
+  reserved[reserved_count].base = base & ~(uint64_t)(PAGE_SIZE - 1);
+  reserved[reserved_count].end = base + length;
+  reserved_count++;
+}
+
+static int pmm_is_reserved(uint64_t addr) {
+  for (int i = 0; i < reserved_count; i++) {
+    if (addr >= reserved[i].base && addr < reserved[i].end)
+      return 1;
+  }
+  return 0;
+}
+
 void pmm_init(struct limine_memmap_response *memmap, uint64_t hhdm) {
   if (memmap == NULL || memmap->entries == NULL) {
-    console_print("PMM: Error - Invalid memory map response\n");
+    printk(PRINTK_ERR, "PMM: Error - Invalid memory map response\n");
     return;
   }
 
   hhdm_offset = hhdm;
-  console_print("PMM: Parsing Memory Map (HHDM: ");
-  console_print_hex(hhdm_offset);
-  console_print(")...\n");
+  printk(PRINTK_INFO, "PMM: Parsing Memory Map (HHDM: 0x%016lx)...\n",
+         hhdm_offset);
 
   for (uint64_t i = 0; i < memmap->entry_count; i++) {
     struct limine_memmap_entry *entry = memmap->entries[i];
@@ -46,7 +72,9 @@ void pmm_init(struct limine_memmap_response *memmap, uint64_t hhdm) {
 
       for (uint64_t addr = aligned_base; addr < aligned_end;
            addr += PAGE_SIZE) {
-         
+        if (pmm_is_reserved(addr))
+          continue;
+
         struct free_page *page = (struct free_page *)(addr + hhdm_offset);
          
          
@@ -61,10 +89,9 @@ void pmm_init(struct limine_memmap_response *memmap, uint64_t hhdm) {
     }
   }
 
-  console_print("PMM: Total RAM detected: ");
-  console_print_dec(usable_memory / (1024 * 1024));
-  console_print(" MB\n");
-  console_print("Scan Complete. PMM Initialized.\n");
+  printk(PRINTK_INFO, "PMM: Total RAM detected: %lu MB\n",
+         usable_memory / (1024 * 1024));
+  printk(PRINTK_INFO, "Scan Complete. PMM Initialized.\n");
 }
 
 void *pmm_alloc_page(void) {
@@ -8,6 +8,9 @@
 void pmm_init(struct limine_memmap_response *memmap, uint64_t hhdm);
 
  
+void pmm_reserve(uint64_t base, uint64_t length);
+
+ 
 void *pmm_alloc_page(void);
 
  
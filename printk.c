@@ -0,0 +1,279 @@
+#include "printk.h"
+#include "console.h"
+#include "irq.h"
+#include "process.h"
+#include "string.h"
+#include "timer.h"
+#include "uart.h"
+#include <stdarg.h>
+#include <stddef.h>
+
+ 
+ 
+ 
+ 
+ 
+struct printk_record {
+  uint64_t seq;
+  uint64_t ts;
+  uint8_t level;
+  uint8_t len;
+  char text[PRINTK_MSG_MAX];
+};
+
+static struct printk_record records[PRINTK_RECORDS];
+static uint64_t printk_head = 0;
+static uint64_t printk_next = 0;
+static uint64_t printk_first = 0;
+static uint64_t printk_lost = 0;
+static uint32_t printk_busy = 0;
+static int console_level = PRINTK_INFO;
+static task_t *klogd_task = NULL;
+
+struct fmt_buf {
+  char *buf;
+  uint32_t len;
+  uint32_t cap;
+};
+
+static inline void fmt_putc(struct fmt_buf *out, char c) {
+  if (out->len < out->cap)
+    out->buf[out->len++] = c;
+}
+
+static void fmt_number(struct fmt_buf *out, uint64_t n, uint32_t base,
+                       int negative, uint32_t width, char pad) {
+  char digits[24];
+  uint32_t i = 0;
+  do {
+    digits[i++] = "0123456789abcdef"[n % base];
+    n /= base;
+  } while (n);
+  if (negative)
+    digits[i++] = '-';
+  while (width > i) {
+    fmt_putc(out, pad);
+    width--;
+  }
+  while (i)
+    fmt_putc(out, digits[--i]);
+}
+
+ 
+ 
+static uint32_t printk_format(char *buf, uint32_t cap, const char *fmt,
+                              va_list ap) {
+  struct fmt_buf out = {buf, 0, cap};
+
+  for (; *fmt; fmt++) {
+    if (*fmt != '%') {
+      fmt_putc(&out, *fmt);
+      continue;
+    }
+    fmt++;
+
+    char pad = ' ';
+    if (*fmt == '0') {
+      pad = '0';
+      fmt++;
+    }
+    uint32_t width = 0;
+    while (*fmt >= '0' && *fmt <= '9')
+      width = width * 10 + (uint32_t)(*fmt++ - '0');
+    int wide = 0;
+    while (*fmt == 'l' || *fmt == 'z') {
+      wide = 1;
+      fmt++;
+    }
+
+    switch (*fmt) {
+    case 'd':
+    case 'i': {
+      int64_t v = wide ? va_arg(ap, int64_t) : va_arg(ap, int);
+      uint64_t mag = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+      fmt_number(&out, mag, 10, v < 0, width, pad);
+      break;
+    }
+    case 'u':
+      fmt_number(&out, wide ? va_arg(ap, uint64_t) : va_arg(ap, uint32_t), 10,
+                 0, width, pad);
+      break;
+    case 'x':
+      fmt_number(&out, wide ? va_arg(ap, uint64_t) : va_arg(ap, uint32_t), 16,
+                 0, width, pad);
+      break;
+    case 'p':
+      fmt_putc(&out, '0');
+      fmt_putc(&out, 'x');
+      fmt_number(&out, (uint64_t)va_arg(ap, void *), 16, 0, 16, '0');
+      break;
+    case 'c':
+      fmt_putc(&out, (char)va_arg(ap, int));
+      break;
+    case 's': {
+      const char *s = va_arg(ap, const char *);
+      if (!s)
+        s = "(null)";
+      while (*s)
+        fmt_putc(&out, *s++);
+      break;
+    }
+    case '\0':
+      return out.len;
+    default:
+      fmt_putc(&out, *fmt);
+      break;
+    }
+  }
+  return out.len;
+}
+
+void printk(int level, const char *fmt, ...) {
+  uint64_t ts = timer_read_counter();
+  uint64_t seq = __atomic_fetch_add(&printk_head, 1, __ATOMIC_RELAXED);
+  struct printk_record *rec = &records[seq % PRINTK_RECORDS];
+
+  __atomic_store_n(&rec->seq, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  va_list ap;
+  va_start(ap, fmt);
+  rec->len = (uint8_t)printk_format(rec->text, PRINTK_MSG_MAX, fmt, ap);
+  va_end(ap);
+  rec->ts = ts;
+  rec->level = (uint8_t)level;
+  __atomic_store_n(&rec->seq, seq + 1, __ATOMIC_RELEASE);
+
+  process_wake(klogd_task);
+}
+
+ 
+ 
+ 
+static int printk_read(uint64_t seq, struct printk_record *out) {
+  const struct printk_record *rec = &records[seq % PRINTK_RECORDS];
+  uint64_t tag = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE);
+  if (tag != seq + 1)
+    return tag > seq + 1 ? -1 : 0;
+
+  *out = *rec;
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  if (__atomic_load_n(&rec->seq, __ATOMIC_RELAXED) != tag)
+    return -1;
+  return 1;
+}
+
+static uint32_t printk_stamp(char *buf, uint64_t ts) {
+  uint64_t us = timer_ticks_to_ns(ts) / 1000;
+  struct fmt_buf out = {buf, 0, 16};
+  fmt_putc(&out, '[');
+  fmt_number(&out, us / 1000000, 10, 0, 5, ' ');
+  fmt_putc(&out, '.');
+  fmt_number(&out, us % 1000000, 10, 0, 6, '0');
+  fmt_putc(&out, ']');
+  fmt_putc(&out, ' ');
+  return out.len;
+}
+
+static void printk_emit(const struct printk_record *rec) {
+  char line[16 + PRINTK_MSG_MAX * 2];
+  uint32_t n = printk_stamp(line, rec->ts);
+  for (uint32_t i = 0; i < rec->len; i++) {
+    if (rec->text[i] == '\n')
+      line[n++] = '\r';
+    line[n++] = rec->text[i];
+  }
+  uart_write(line, n);
+
+  if (rec->level <= console_level) {
+    k_memcpy(line, rec->text, rec->len);
+    line[rec->len] = '\0';
+    console_print(line);
+  }
+}
+
+void printk_flush(void) {
+  if (__atomic_exchange_n(&printk_busy, 1, __ATOMIC_ACQUIRE))
+    return;
+
+  struct printk_record rec;
+  uint64_t head = __atomic_load_n(&printk_head, __ATOMIC_ACQUIRE);
+  while (printk_next != head) {
+    if (head - printk_next > PRINTK_RECORDS) {
+      printk_lost += head - printk_next - PRINTK_RECORDS;
+      printk_next = head - PRINTK_RECORDS;
+    }
+    int r = printk_read(printk_next, &rec);
+    if (r == 0)
+      break;
+    printk_next++;
+    if (r < 0) {
+      printk_lost++;
+      continue;
+    }
+    printk_emit(&rec);
+  }
+
+  __atomic_store_n(&printk_busy, 0, __ATOMIC_RELEASE);
+}
+
+static void klogd_thread(void) {
+  for (;;) {
+    uint64_t flags = local_irq_save();
+    if (__atomic_load_n(&printk_head, __ATOMIC_ACQUIRE) == printk_next)
+      current_task->state = TASK_BLOCKED;
+    local_irq_restore(flags);
+
+    if (current_task->state == TASK_BLOCKED) {
+      schedule();
+      continue;
+    }
+    printk_flush();
+    yield();
+  }
+}
+
+void printk_start(void) {
+  if (klogd_task)
+    return;
+  klogd_task = process_create(klogd_thread, "klogd");
+  if (!klogd_task)
+    console_print("PRINTK: Failed to create klogd task!\n");
+}
+
+void printk_set_console_level(int level) { console_level = level; }
+
+void printk_dump(void) {
+  static const char levels[8] = "EACEWNID";
+  struct printk_record rec;
+  char line[16 + PRINTK_MSG_MAX + 4];
+  uint64_t head = __atomic_load_n(&printk_head, __ATOMIC_ACQUIRE);
+  uint64_t seq = head > PRINTK_RECORDS ? head - PRINTK_RECORDS : 0;
+  if (seq < printk_first)
+    seq = printk_first;
+
+  for (; seq != head; seq++) {
+    if (printk_read(seq, &rec) <= 0)
+      continue;
+    uint32_t n = printk_stamp(line, rec.ts);
+    line[n++] = levels[rec.level & 7];
+    line[n++] = ' ';
+    k_memcpy(line + n, rec.text, rec.len);
+    n += rec.len;
+    if (!rec.len || rec.text[rec.len - 1] != '\n')
+      line[n++] = '\n';
+    line[n] = '\0';
+    console_print(line);
+  }
+
+  if (printk_lost) {
+    console_print("(");
+    console_print_dec(printk_lost);
+    console_print(" messages lost)\n");
+  }
+}
+
+void printk_clear(void) {
+  printk_first = __atomic_load_n(&printk_head, __ATOMIC_ACQUIRE);
+  printk_lost = 0;
+}
@@ -0,0 +1,36 @@
+#ifndef PRINTK_H
+#define PRINTK_H
+
+#include <stdint.h>
+
+#define PRINTK_ERR 3
+#define PRINTK_WARN 4
+#define PRINTK_INFO 6
+#define PRINTK_DEBUG 7
+
+ 
+#define PRINTK_RECORDS 512
+#define PRINTK_MSG_MAX 110
+
+ 
+ 
+ 
+ 
+void printk(int level, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+ 
+ 
+void printk_start(void);
+
+ 
+ 
+void printk_flush(void);
+
+void printk_set_console_level(int level);
+
+ 
+void printk_dump(void);
+void printk_clear(void);
+
+#endif
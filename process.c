@@ -1,6 +1,9 @@
 #include "process.h"
 #include "console.h"
 #include "heap.h"
+#include "printk.h"
+#include "rcu.h"
+#include "smp.h"
 #include "string.h"
 
 task_t *current_task = NULL;
@@ -28,7 +31,7 @@ void process_init(void) {
   current_task = kernel_task;
   task_list = kernel_task;
 
-  console_print("PROCESS: Multitasking Initialized.\n");
+  printk(PRINTK_INFO, "PROCESS: Multitasking Initialized.\n");
 }
 
 task_t *process_create(void (*entry)(void), const char *name) {
@@ -80,6 +83,9 @@ void schedule(void) {
   if (!current_task)
     return;
 
+  rcu_quiescent_state();
+  smp_need_resched();
+
   task_t *next = current_task->next;
    
    
@@ -95,9 +101,22 @@ void schedule(void) {
   task_t *prev = current_task;
   current_task = next;
   current_task->state = TASK_RUNNING;
-  prev->state = TASK_READY;
+  if (prev->state == TASK_RUNNING)
+    prev->state = TASK_READY;
 
   switch_to(prev, next);
 }
 
 void yield(void) { schedule(); }
+
+void cond_resched(void) {
+  if (smp_need_resched())
+    schedule();
+}
+
+void process_wake(task_t *task) {
+  if (!task || task->state != TASK_BLOCKED)
+    return;
+  task->state = TASK_READY;
+  smp_send_reschedule(0);
+}
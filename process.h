@@ -27,5 +27,7 @@ void process_init(void);
 task_t *process_create(void (*entry)(void), const char *name);
 void schedule(void);
 void yield(void);
+void cond_resched(void);
+void process_wake(task_t *task);
 
 #endif  
@@ -0,0 +1,121 @@
+#include "rcu.h"
+#include "printk.h"
+#include "process.h"
+#include "smp.h"
+
+struct rcu_cpu {
+  uint64_t qs_seq;
+  int online;
+  int idle;
+  struct rcu_head *cb_head;
+  struct rcu_head **cb_tail;
+} __attribute__((aligned(64)));
+
+static struct rcu_cpu rcu_cpus[MAX_CPUS];
+static uint64_t rcu_gp_started = 0;
+static uint64_t rcu_gp_completed = 0;
+
+void rcu_init(void) {
+  for (int i = 0; i < MAX_CPUS; i++) {
+    rcu_cpus[i].qs_seq = 0;
+    rcu_cpus[i].online = 0;
+    rcu_cpus[i].idle = 0;
+    rcu_cpus[i].cb_head = NULL;
+    rcu_cpus[i].cb_tail = &rcu_cpus[i].cb_head;
+  }
+  rcu_cpu_online(smp_processor_id());
+
+  printk(PRINTK_INFO, "RCU: Initialized.\n");
+}
+
+void rcu_cpu_online(uint32_t cpu) {
+  if (cpu >= MAX_CPUS)
+    return;
+  __atomic_store_n(&rcu_cpus[cpu].qs_seq,
+                   __atomic_load_n(&rcu_gp_started, __ATOMIC_ACQUIRE),
+                   __ATOMIC_RELEASE);
+  __atomic_store_n(&rcu_cpus[cpu].online, 1, __ATOMIC_RELEASE);
+}
+
+static void rcu_start_gp(void) {
+  uint64_t done = __atomic_load_n(&rcu_gp_completed, __ATOMIC_ACQUIRE);
+  uint64_t expected = done;
+  __atomic_compare_exchange_n(&rcu_gp_started, &expected, done + 1, 0,
+                              __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+static void rcu_try_complete_gp(void) {
+  uint64_t gp = __atomic_load_n(&rcu_gp_started, __ATOMIC_ACQUIRE);
+  if (gp == __atomic_load_n(&rcu_gp_completed, __ATOMIC_ACQUIRE))
+    return;
+
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  for (int i = 0; i < MAX_CPUS; i++) {
+    if (!__atomic_load_n(&rcu_cpus[i].online, __ATOMIC_ACQUIRE))
+      continue;
+    if (__atomic_load_n(&rcu_cpus[i].idle, __ATOMIC_ACQUIRE))
+      continue;
+    if (__atomic_load_n(&rcu_cpus[i].qs_seq, __ATOMIC_ACQUIRE) < gp)
+      return;
+  }
+
+  uint64_t expected = gp - 1;
+  __atomic_compare_exchange_n(&rcu_gp_completed, &expected, gp, 0,
+                              __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+void call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *head)) {
+  struct rcu_cpu *rc = &rcu_cpus[smp_processor_id()];
+
+  head->func = func;
+  head->next = NULL;
+  head->gp = __atomic_load_n(&rcu_gp_started, __ATOMIC_ACQUIRE) + 1;
+
+  *rc->cb_tail = head;
+  rc->cb_tail = &head->next;
+
+  rcu_start_gp();
+}
+
+void rcu_quiescent_state(void) {
+  struct rcu_cpu *rc = &rcu_cpus[smp_processor_id()];
+
+  __atomic_store_n(&rc->qs_seq,
+                   __atomic_load_n(&rcu_gp_started, __ATOMIC_ACQUIRE),
+                   __ATOMIC_RELEASE);
+  rcu_try_complete_gp();
+
+  uint64_t done = __atomic_load_n(&rcu_gp_completed, __ATOMIC_ACQUIRE);
+  while (rc->cb_head && rc->cb_head->gp <= done) {
+    struct rcu_head *head = rc->cb_head;
+    rc->cb_head = head->next;
+    if (!rc->cb_head)
+      rc->cb_tail = &rc->cb_head;
+    head->func(head);
+  }
+
+  if (rc->cb_head)
+    rcu_start_gp();
+}
+
+void rcu_idle_enter(void) {
+  struct rcu_cpu *rc = &rcu_cpus[smp_processor_id()];
+  __atomic_store_n(&rc->idle, 1, __ATOMIC_RELEASE);
+}
+
+void rcu_idle_exit(void) {
+  struct rcu_cpu *rc = &rcu_cpus[smp_processor_id()];
+  __atomic_store_n(&rc->idle, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void synchronize_rcu(void) {
+  uint64_t target = __atomic_load_n(&rcu_gp_started, __ATOMIC_ACQUIRE) + 1;
+
+  while (__atomic_load_n(&rcu_gp_completed, __ATOMIC_ACQUIRE) < target) {
+    rcu_start_gp();
+    rcu_quiescent_state();
+    if (__atomic_load_n(&rcu_gp_completed, __ATOMIC_ACQUIRE) < target)
+      yield();
+  }
+}
@@ -0,0 +1,34 @@
+#ifndef RCU_H
+#define RCU_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct rcu_head {
+  struct rcu_head *next;
+  void (*func)(struct rcu_head *head);
+  uint64_t gp;
+};
+
+#define container_of(ptr, type, member)                                        \
+  ((type *)((uint8_t *)(ptr) - offsetof(type, member)))
+
+#define rcu_dereference(p) (*(volatile __typeof__(p) *)&(p))
+
+#define rcu_assign_pointer(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+static inline void rcu_read_lock(void) { __asm__ volatile("" ::: "memory"); }
+
+static inline void rcu_read_unlock(void) { __asm__ volatile("" ::: "memory"); }
+
+void rcu_init(void);
+void rcu_cpu_online(uint32_t cpu);
+
+void call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *head));
+void synchronize_rcu(void);
+
+void rcu_quiescent_state(void);
+void rcu_idle_enter(void);
+void rcu_idle_exit(void);
+
+#endif
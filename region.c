@@ -0,0 +1,163 @@
+#include "region.h"
+
+int rect_intersect(const rect_t *a, const rect_t *b, rect_t *out) {
+  rect_t r;
+  r.x0 = a->x0 > b->x0 ? a->x0 : b->x0;
+  r.y0 = a->y0 > b->y0 ? a->y0 : b->y0;
+  r.x1 = a->x1 < b->x1 ? a->x1 : b->x1;
+  r.y1 = a->y1 < b->y1 ? a->y1 : b->y1;
+  if (rect_empty(&r))
+    return 0;
+  if (out)
+    *out = r;
+  return 1;
+}
+
+rect_t rect_union(const rect_t *a, const rect_t *b) {
+  rect_t r;
+  r.x0 = a->x0 < b->x0 ? a->x0 : b->x0;
+  r.y0 = a->y0 < b->y0 ? a->y0 : b->y0;
+  r.x1 = a->x1 > b->x1 ? a->x1 : b->x1;
+  r.y1 = a->y1 > b->y1 ? a->y1 : b->y1;
+  return r;
+}
+
+static int rect_contains(const rect_t *outer, const rect_t *inner) {
+  return inner->x0 >= outer->x0 && inner->y0 >= outer->y0 &&
+         inner->x1 <= outer->x1 && inner->y1 <= outer->y1;
+}
+
+static int rect_touches(const rect_t *a, const rect_t *b) {
+  return a->x0 <= b->x1 && b->x0 <= a->x1 && a->y0 <= b->y1 &&
+         b->y0 <= a->y1;
+}
+
+static void region_remove(region_t *reg, int i) {
+  reg->rects[i] = reg->rects[--reg->count];
+}
+
+void region_init(region_t *reg) { reg->count = 0; }
+
+int region_subtract_rect(region_t *reg, const rect_t *cut) {
+  int exact = 0;
+  for (int i = 0; i < reg->count;) {
+    rect_t r = reg->rects[i];
+    rect_t x;
+    if (!rect_intersect(&r, cut, &x)) {
+      i++;
+      continue;
+    }
+
+    rect_t pieces[4];
+    int n = 0;
+    if (r.y0 < x.y0)
+      pieces[n++] = (rect_t){r.x0, r.y0, r.x1, x.y0};
+    if (x.y1 < r.y1)
+      pieces[n++] = (rect_t){r.x0, x.y1, r.x1, r.y1};
+    if (r.x0 < x.x0)
+      pieces[n++] = (rect_t){r.x0, x.y0, x.x0, x.y1};
+    if (x.x1 < r.x1)
+      pieces[n++] = (rect_t){x.x1, x.y0, r.x1, x.y1};
+
+    if (reg->count - 1 + n > REGION_MAX_RECTS) {
+      exact = -1;
+      i++;
+      continue;
+    }
+    region_remove(reg, i);
+    for (int p = 0; p < n; p++)
+      reg->rects[reg->count++] = pieces[p];
+  }
+  return exact;
+}
+
+void region_intersect_rect(region_t *dst, const region_t *src,
+                           const rect_t *clip) {
+  dst->count = 0;
+  for (int i = 0; i < src->count; i++) {
+    rect_t r;
+    if (rect_intersect(&src->rects[i], clip, &r))
+      dst->rects[dst->count++] = r;
+  }
+}
+
+static void region_collapse(region_t *reg, const rect_t *r) {
+  rect_t bounds = *r;
+  for (int i = 0; i < reg->count; i++)
+    bounds = rect_union(&bounds, &reg->rects[i]);
+  reg->rects[0] = bounds;
+  reg->count = 1;
+}
+
+ 
+ 
+ 
+ 
+void region_add(region_t *reg, rect_t r) {
+  if (rect_empty(&r))
+    return;
+
+restart:
+  for (int i = 0; i < reg->count; i++) {
+    rect_t *cur = &reg->rects[i];
+    if (rect_contains(cur, &r))
+      return;
+    if (rect_contains(&r, cur)) {
+      region_remove(reg, i);
+      goto restart;
+    }
+    if (!rect_touches(cur, &r))
+      continue;
+
+    rect_t u = rect_union(cur, &r);
+    if (rect_area(&u) <= rect_area(cur) + rect_area(&r)) {
+      region_remove(reg, i);
+      r = u;
+      goto restart;
+    }
+  }
+
+  region_t pieces;
+  pieces.count = 1;
+  pieces.rects[0] = r;
+  for (int i = 0; i < reg->count && pieces.count; i++) {
+    if (region_subtract_rect(&pieces, &reg->rects[i]) < 0) {
+      region_collapse(reg, &r);
+      return;
+    }
+  }
+
+  if (reg->count + pieces.count > REGION_MAX_RECTS) {
+    region_collapse(reg, &r);
+    return;
+  }
+  for (int i = 0; i < pieces.count; i++)
+    reg->rects[reg->count++] = pieces.rects[i];
+}
+
+void region_add_region(region_t *reg, const region_t *src, int dx, int dy) {
+  for (int i = 0; i < src->count; i++) {
+    rect_t r = src->rects[i];
+    r.x0 += dx;
+    r.x1 += dx;
+    r.y0 += dy;
+    r.y1 += dy;
+    region_add(reg, r);
+  }
+}
+
+void region_clip(region_t *reg, const rect_t *bounds) {
+  for (int i = 0; i < reg->count;) {
+    if (rect_intersect(&reg->rects[i], bounds, &reg->rects[i]))
+      i++;
+    else
+      region_remove(reg, i);
+  }
+}
+
+int64_t region_area(const region_t *reg) {
+  int64_t area = 0;
+  for (int i = 0; i < reg->count; i++)
+    area += rect_area(&reg->rects[i]);
+  return area;
+}
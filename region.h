@@ -0,0 +1,51 @@
+#ifndef REGION_H
+#define REGION_H
+
+#include <stdint.h>
+
+#define REGION_MAX_RECTS 32
+
+ 
+typedef struct rect {
+  int x0, y0;
+  int x1, y1;
+} rect_t;
+
+ 
+ 
+ 
+typedef struct region {
+  int count;
+  rect_t rects[REGION_MAX_RECTS];
+} region_t;
+
+static inline rect_t rect_make(int x, int y, int w, int h) {
+  rect_t r = {x, y, x + w, y + h};
+  return r;
+}
+
+static inline int rect_empty(const rect_t *r) {
+  return r->x0 >= r->x1 || r->y0 >= r->y1;
+}
+
+static inline int64_t rect_area(const rect_t *r) {
+  return rect_empty(r) ? 0 : (int64_t)(r->x1 - r->x0) * (r->y1 - r->y0);
+}
+
+int rect_intersect(const rect_t *a, const rect_t *b, rect_t *out);
+rect_t rect_union(const rect_t *a, const rect_t *b);
+
+void region_init(region_t *reg);
+void region_add(region_t *reg, rect_t r);
+int region_subtract_rect(region_t *reg, const rect_t *cut);
+void region_intersect_rect(region_t *dst, const region_t *src,
+                           const rect_t *clip);
+void region_add_region(region_t *reg, const region_t *src, int dx, int dy);
+void region_clip(region_t *reg, const rect_t *bounds);
+int64_t region_area(const region_t *reg);
+
+static inline int region_empty(const region_t *reg) { return reg->count == 0; }
+
+static inline void region_clear(region_t *reg) { reg->count = 0; }
+
+#endif
@@ -1,14 +1,21 @@
 #include "shell.h"
+#include "bench.h"
+#include "bootprof.h"
+#include "compositor.h"
 #include "console.h"
+#include "crash.h"
 #include "donut.h"
 #include "editor.h"
 #include "fetch_logo.h"
 #include "gui.h"
 #include "heap.h"
+#include "irq.h"
 #include "keyboard.h"
 #include "mouse.h"
 #include "pmm.h"
+#include "printk.h"
 #include "process.h"
+#include "rcu.h"
 #include "string.h"
 #include "uart.h"
 #include "vfs.h"
@@ -44,6 +51,10 @@ static void cmd_help(void) {
   console_print("  help       - Show this help\n");
   console_print("  fetch      - Show system info\n");
   console_print("  halt       - Stop the CPU\n");
+  console_print("  reboot     - Warm reboot via PSCI\n");
+  console_print("  crashlog   - Show saved crash records (clear)\n");
+  console_print("  dmesg      - Show the kernel log buffer (clear)\n");
+  console_print("  boottime   - Show how long each boot phase took\n");
   console_print("  memtest    - Run memory allocation test\n");
   console_print("  ls         - List directory contents\n");
   console_print("  mkdir <d>  - Create a directory\n");
@@ -62,6 +73,14 @@ static void cmd_help(void) {
   console_print("  mouse      - Mouse demo 🖱️\n");
   console_print("  desktop    - Launch Plasma Desktop\n");
   console_print("  multitask  - Run multitasking demo\n");
+  console_print("  irqstat    - Show per-IRQ counts and latency\n");
+  console_print("  uartstat   - Show serial ring and interrupt counters\n");
+  console_print("  irqbench [n] - Measure IRQ entry/exit cost\n");
+  console_print("  fbbench [n]  - Measure framebuffer scanout FPS\n");
+  console_print("  blendbench [n] - Measure alpha blend throughput\n");
+  console_print("  compbench [n]  - Compose frame time vs CPU count\n");
+  console_print("  compstat   - Show compositor damage and overdraw\n");
+  console_print("  refresh [hz] - Show or set compositor refresh rate\n");
 }
 
 static void cmd_fetch(void) {
@@ -321,6 +340,70 @@ static void cmd_multitask(void) {
   console_print("Test Complete.\n");
 }
 
+static uint32_t parse_uint(const char *s, uint32_t fallback) {
+  if (!s || *s < '0' || *s > '9')
+    return fallback;
+  uint32_t n = 0;
+  while (*s >= '0' && *s <= '9')
+    n = n * 10 + (uint32_t)(*s++ - '0');
+  return n;
+}
+
+static void cmd_irqstat(void) { irq_print_stats(); }
+
+static void cmd_uartstat(void) { uart_print_stats(); }
+
+static void cmd_irqbench(char *args) {
+  irq_benchmark(parse_uint(args, 1000));
+}
+
+static void cmd_fbbench(char *args) { bench_scanout(parse_uint(args, 30)); }
+
+static void cmd_blendbench(char *args) { bench_blend(parse_uint(args, 20)); }
+
+static void cmd_compbench(char *args) { bench_compose(parse_uint(args, 20)); }
+
+static void cmd_compstat(void) { compositor_print_stats(); }
+
+static void cmd_refresh(char *args) {
+  uint32_t hz = parse_uint(args, 0);
+  if (hz) {
+    if (hz > 240) {
+      console_print("Error: refresh rate must be 1-240 Hz\n");
+      return;
+    }
+    compositor_set_refresh(hz);
+  }
+  console_print("Compositor refresh: ");
+  console_print_dec(compositor_get_refresh());
+  console_print(" Hz\n");
+}
+
+static void cmd_crashlog(char *args) {
+  if (args && k_strcmp(args, "clear") == 0) {
+    crash_clear();
+    console_print("Crash log cleared.\n");
+    return;
+  }
+  crash_print_log();
+}
+
+static void cmd_dmesg(char *args) {
+  if (args && k_strcmp(args, "clear") == 0) {
+    printk_clear();
+    console_print("Kernel log cleared.\n");
+    return;
+  }
+  printk_dump();
+}
+
+static void cmd_boottime(void) { bootprof_print(); }
+
+static void cmd_reboot(void) {
+  console_print("Rebooting...\n");
+  crash_reboot();
+}
+
 static void cmd_unknown(const char *cmd) {
   console_print("Error: Unknown command '");
   console_print(cmd);
@@ -365,25 +448,11 @@ static void cmd_rm(char *args) {
     return;
   }
 
-  fs_node_t *parent = cwd;
-  fs_node_t *prev = NULL;
-  fs_node_t *curr = (fs_node_t *)parent->ptr;
-
-  while (curr) {
-    if (curr == file) {
-      if (prev) {
-        prev->next = curr->next;
-      } else {
-        parent->ptr = curr->next;
-      }
-
-      console_print("Removed: ");
-      console_print(args);
-      console_print("\n");
-      return;
-    }
-    prev = curr;
-    curr = curr->next;
+  if (vfs_unlink(cwd, args) == 0) {
+    console_print("Removed: ");
+    console_print(args);
+    console_print("\n");
+    return;
   }
   console_print("Error: Could not remove file\n");
 }
@@ -413,24 +482,11 @@ static void cmd_rmdir(char *args) {
     return;
   }
 
-  fs_node_t *parent = cwd;
-  fs_node_t *prev = NULL;
-  fs_node_t *curr = (fs_node_t *)parent->ptr;
-
-  while (curr) {
-    if (curr == dir) {
-      if (prev) {
-        prev->next = curr->next;
-      } else {
-        parent->ptr = curr->next;
-      }
-      console_print("Removed directory: ");
-      console_print(args);
-      console_print("\n");
-      return;
-    }
-    prev = curr;
-    curr = curr->next;
+  if (vfs_unlink(cwd, args) == 0) {
+    console_print("Removed directory: ");
+    console_print(args);
+    console_print("\n");
+    return;
   }
   console_print("Error: Could not remove directory\n");
 }
@@ -590,6 +646,30 @@ static void process_command(char *cmd) {
     cmd_cd(args);
   } else if (k_strcmp(cmd, "multitask") == 0) {
     cmd_multitask();
+  } else if (k_strcmp(cmd, "irqstat") == 0) {
+    cmd_irqstat();
+  } else if (k_strcmp(cmd, "uartstat") == 0) {
+    cmd_uartstat();
+  } else if (k_strcmp(cmd, "irqbench") == 0) {
+    cmd_irqbench(args);
+  } else if (k_strcmp(cmd, "fbbench") == 0) {
+    cmd_fbbench(args);
+  } else if (k_strcmp(cmd, "blendbench") == 0) {
+    cmd_blendbench(args);
+  } else if (k_strcmp(cmd, "compbench") == 0) {
+    cmd_compbench(args);
+  } else if (k_strcmp(cmd, "compstat") == 0) {
+    cmd_compstat();
+  } else if (k_strcmp(cmd, "refresh") == 0) {
+    cmd_refresh(args);
+  } else if (k_strcmp(cmd, "crashlog") == 0) {
+    cmd_crashlog(args);
+  } else if (k_strcmp(cmd, "dmesg") == 0) {
+    cmd_dmesg(args);
+  } else if (k_strcmp(cmd, "boottime") == 0) {
+    cmd_boottime();
+  } else if (k_strcmp(cmd, "reboot") == 0) {
+    cmd_reboot();
   } else if (k_strcmp(cmd, "echo") == 0) {
     cmd_echo(args);
   } else if (k_strcmp(cmd, "pwd") == 0) {
@@ -709,6 +789,9 @@ void shell_run(void) {
     while (1) {
       int c = 0;
 
+      rcu_quiescent_state();
+      cond_resched();
+
       for (int i = 0; i < 50000; i++) {
         if (keyboard_has_char()) {
           c = keyboard_getc();
@@ -732,7 +815,11 @@ void shell_run(void) {
 
       console_set_cursor_visible(0);
 
-      if (c == KEY_UP) {
+      if (c == KEY_PGUP) {
+        console_scroll_view((int)(console_get_height() / 2));
+      } else if (c == KEY_PGDN) {
+        console_scroll_view(-(int)(console_get_height() / 2));
+      } else if (c == KEY_UP) {
         if (history_pos > 0) {
           history_pos--;
 
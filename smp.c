@@ -0,0 +1,354 @@
+#include "smp.h"
+#include "blend.h"
+#include "gic.h"
+#include "heap.h"
+#include "irq.h"
+#include "limine.h"
+#include "printk.h"
+#include "rcu.h"
+#include "softirq.h"
+#include <stddef.h>
+
+__attribute__((
+    used,
+    section(".limine_requests"))) static volatile struct limine_smp_request
+    smp_request = {.id = LIMINE_SMP_REQUEST, .revision = 0};
+
+#define AP_STACK_SIZE 16384
+#define AP_BOOT_TIMEOUT 100000000
+#define CALL_FLAG_LOCK 1
+
+struct smp_cpu {
+  struct smp_call *call_queue;
+  struct smp_call csd[MAX_CPUS];
+  int need_resched;
+  int online;
+  uint64_t mpidr;
+} __attribute__((aligned(64)));
+
+struct smp_boot_args {
+  uint64_t stack_top;
+  uint64_t cpu;
+};
+
+struct smp_parallel {
+  smp_parallel_func_t func;
+  void *info;
+  uint32_t count;
+  uint32_t max_cpus;
+  uint32_t next;
+  uint32_t done;
+  uint32_t active;
+  int running;
+};
+
+static struct smp_cpu smp_cpus[MAX_CPUS];
+static struct smp_parallel smp_parallel_job;
+static struct smp_boot_args smp_boot_args[MAX_CPUS];
+static uint32_t smp_cpu_count = 1;
+
+extern void smp_ap_start(struct limine_smp_info *info);
+
+static void smp_ipi_handler(uint32_t irq, void *ctx);
+
+static inline void cpu_relax(void) { __asm__ volatile("yield" ::: "memory"); }
+
+static void smp_parallel_work(struct smp_parallel *job) {
+  for (;;) {
+    uint32_t i = __atomic_fetch_add(&job->next, 1, __ATOMIC_ACQ_REL);
+    if (i >= job->count)
+      break;
+    job->func(job->info, i);
+    __atomic_fetch_add(&job->done, 1, __ATOMIC_RELEASE);
+  }
+}
+
+ 
+ 
+ 
+static void smp_parallel_join(uint32_t cpu) {
+  struct smp_parallel *job = &smp_parallel_job;
+  if (!__atomic_load_n(&job->running, __ATOMIC_ACQUIRE))
+    return;
+
+  __atomic_fetch_add(&job->active, 1, __ATOMIC_ACQ_REL);
+  if (__atomic_load_n(&job->running, __ATOMIC_ACQUIRE) &&
+      cpu < job->max_cpus)
+    smp_parallel_work(job);
+  __atomic_fetch_sub(&job->active, 1, __ATOMIC_RELEASE);
+}
+
+void smp_ap_main(struct smp_boot_args *args) {
+  uint32_t cpu = (uint32_t)args->cpu;
+  struct smp_cpu *c = &smp_cpus[cpu];
+
+  smp_set_processor_id(cpu);
+  fpsimd_enable();
+  irq_cpu_init();
+  rcu_cpu_online(cpu);
+  __atomic_store_n(&c->online, 1, __ATOMIC_RELEASE);
+
+  for (;;) {
+    smp_parallel_join(cpu);
+    rcu_quiescent_state();
+    local_irq_disable();
+    do_softirq();
+    rcu_idle_enter();
+    if (!__atomic_load_n(&c->call_queue, __ATOMIC_ACQUIRE) &&
+        !__atomic_load_n(&c->need_resched, __ATOMIC_ACQUIRE) &&
+        !__atomic_load_n(&smp_parallel_job.running, __ATOMIC_ACQUIRE))
+      __asm__ volatile("wfi");
+    rcu_idle_exit();
+    local_irq_enable();
+    __atomic_store_n(&c->need_resched, 0, __ATOMIC_RELAXED);
+  }
+}
+
+void smp_init(void) {
+  uint32_t self = smp_processor_id();
+  smp_cpus[self].online = 1;
+  irq_register(IPI_RESCHEDULE, smp_ipi_handler, NULL);
+  irq_register(IPI_CALL_FUNC, smp_ipi_handler, NULL);
+
+  struct limine_smp_response *resp = smp_request.response;
+  if (resp == NULL) {
+    printk(PRINTK_INFO, "SMP: No MP response, running on 1 CPU.\n");
+    return;
+  }
+  smp_cpus[self].mpidr = resp->bsp_mpidr;
+
+  uint32_t max_cpus = gic_max_cpus();
+  if (max_cpus > MAX_CPUS)
+    max_cpus = MAX_CPUS;
+  if (resp->cpu_count > max_cpus) {
+    printk(PRINTK_WARN,
+           "SMP: Interrupt controller limits bring-up to %u CPUs.\n",
+           max_cpus);
+  }
+
+  uint32_t next = 1;
+  for (uint64_t i = 0; i < resp->cpu_count && next < max_cpus; i++) {
+    struct limine_smp_info *info = resp->cpus[i];
+    if (info->mpidr == resp->bsp_mpidr)
+      continue;
+
+    uint8_t *stack = (uint8_t *)malloc(AP_STACK_SIZE);
+    if (!stack)
+      break;
+
+    smp_cpus[next].mpidr = info->mpidr;
+    smp_boot_args[next].stack_top = (uint64_t)(stack + AP_STACK_SIZE);
+    smp_boot_args[next].cpu = next;
+    info->extra_argument = (uint64_t)&smp_boot_args[next];
+    __atomic_store_n(&info->goto_address, smp_ap_start, __ATOMIC_RELEASE);
+    __asm__ volatile("dsb sy\n"
+                     "sev" ::: "memory");
+
+    for (uint64_t t = 0; t < AP_BOOT_TIMEOUT; t++) {
+      if (__atomic_load_n(&smp_cpus[next].online, __ATOMIC_ACQUIRE))
+        break;
+      cpu_relax();
+    }
+    if (!smp_cpus[next].online) {
+      printk(PRINTK_ERR, "SMP: CPU failed to start, MPIDR 0x%016lx\n",
+             info->mpidr);
+    }
+    next++;
+  }
+  smp_cpu_count = next;
+
+  uint32_t online = 0;
+  for (uint32_t cpu = 0; cpu < smp_cpu_count; cpu++) {
+    if (smp_cpu_online(cpu))
+      online++;
+  }
+  printk(PRINTK_INFO, "SMP: %u CPUs online.\n", online);
+}
+
+uint32_t smp_num_cpus(void) { return smp_cpu_count; }
+
+int smp_cpu_online(uint32_t cpu) {
+  if (cpu >= MAX_CPUS)
+    return 0;
+  return __atomic_load_n(&smp_cpus[cpu].online, __ATOMIC_ACQUIRE);
+}
+
+static void smp_run_call_queue(struct smp_cpu *c) {
+  struct smp_call *list =
+      __atomic_exchange_n(&c->call_queue, NULL, __ATOMIC_ACQUIRE);
+
+  struct smp_call *fifo = NULL;
+  while (list) {
+    struct smp_call *next = list->next;
+    list->next = fifo;
+    fifo = list;
+    list = next;
+  }
+
+  while (fifo) {
+    struct smp_call *call = fifo;
+    fifo = call->next;
+    call->func(call->info);
+    __atomic_store_n(&call->flags, 0, __ATOMIC_RELEASE);
+  }
+}
+
+static void smp_ipi_handler(uint32_t irq, void *ctx) {
+  (void)ctx;
+  struct smp_cpu *c = &smp_cpus[smp_processor_id()];
+
+  if (irq == IPI_RESCHEDULE) {
+    __atomic_store_n(&c->need_resched, 1, __ATOMIC_RELEASE);
+  } else if (irq == IPI_CALL_FUNC) {
+    smp_run_call_queue(c);
+  }
+}
+
+void smp_send_reschedule(uint32_t cpu) {
+  if (!smp_cpu_online(cpu))
+    return;
+  if (cpu == smp_processor_id()) {
+    __atomic_store_n(&smp_cpus[cpu].need_resched, 1, __ATOMIC_RELEASE);
+    return;
+  }
+  gic_send_sgi(1ull << cpu, IPI_RESCHEDULE);
+}
+
+int smp_need_resched(void) {
+  return __atomic_exchange_n(&smp_cpus[smp_processor_id()].need_resched, 0,
+                             __ATOMIC_ACQ_REL);
+}
+
+static void smp_call_lock(struct smp_call *call) {
+  while (__atomic_load_n(&call->flags, __ATOMIC_ACQUIRE) & CALL_FLAG_LOCK)
+    cpu_relax();
+  call->flags = CALL_FLAG_LOCK;
+}
+
+static void smp_call_wait(struct smp_call *call) {
+  while (__atomic_load_n(&call->flags, __ATOMIC_ACQUIRE) & CALL_FLAG_LOCK)
+    cpu_relax();
+}
+
+static int smp_queue_call(uint32_t cpu, struct smp_call *call) {
+  struct smp_cpu *c = &smp_cpus[cpu];
+  struct smp_call *head = __atomic_load_n(&c->call_queue, __ATOMIC_RELAXED);
+  do {
+    call->next = head;
+  } while (!__atomic_compare_exchange_n(&c->call_queue, &head, call, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+  return head == NULL;
+}
+
+int smp_call_function_single(uint32_t cpu, smp_call_func_t func, void *info,
+                             int wait) {
+  uint32_t self = smp_processor_id();
+
+  if (cpu == self) {
+    uint64_t flags = local_irq_save();
+    func(info);
+    local_irq_restore(flags);
+    return 0;
+  }
+  if (!smp_cpu_online(cpu))
+    return -1;
+
+  struct smp_call on_stack;
+  struct smp_call *call = wait ? &on_stack : &smp_cpus[self].csd[cpu];
+  if (wait)
+    on_stack.flags = 0;
+  smp_call_lock(call);
+  call->func = func;
+  call->info = info;
+
+  if (smp_queue_call(cpu, call))
+    gic_send_sgi(1ull << cpu, IPI_CALL_FUNC);
+
+  if (wait)
+    smp_call_wait(call);
+  return 0;
+}
+
+void smp_call_function(smp_call_func_t func, void *info, int wait) {
+  uint32_t self = smp_processor_id();
+  struct smp_call *csd = smp_cpus[self].csd;
+  uint64_t targets = 0;
+
+  for (uint32_t cpu = 0; cpu < smp_cpu_count; cpu++) {
+    if (cpu == self || !smp_cpu_online(cpu))
+      continue;
+
+    struct smp_call *call = &csd[cpu];
+    smp_call_lock(call);
+    call->func = func;
+    call->info = info;
+
+    if (smp_queue_call(cpu, call))
+      targets |= 1ull << cpu;
+  }
+
+  if (targets)
+    gic_send_sgi(targets, IPI_CALL_FUNC);
+
+  if (!wait)
+    return;
+  for (uint32_t cpu = 0; cpu < smp_cpu_count; cpu++) {
+    if (cpu == self || !smp_cpu_online(cpu))
+      continue;
+    smp_call_wait(&csd[cpu]);
+  }
+}
+
+void smp_parallel_for(smp_parallel_func_t func, void *info, uint32_t count,
+                      uint32_t max_cpus) {
+  if (max_cpus == 0 || max_cpus > smp_cpu_count)
+    max_cpus = smp_cpu_count;
+  if (max_cpus <= 1 || count <= 1) {
+    for (uint32_t i = 0; i < count; i++)
+      func(info, i);
+    return;
+  }
+
+  struct smp_parallel *job = &smp_parallel_job;
+  job->func = func;
+  job->info = info;
+  job->count = count;
+  job->max_cpus = max_cpus;
+  job->next = 0;
+  job->done = 0;
+  __atomic_store_n(&job->running, 1, __ATOMIC_RELEASE);
+
+  uint32_t self = smp_processor_id();
+  uint64_t targets = 0;
+  for (uint32_t cpu = 0; cpu < max_cpus; cpu++) {
+    if (cpu != self && smp_cpu_online(cpu))
+      targets |= 1ull << cpu;
+  }
+  if (targets)
+    gic_send_sgi(targets, IPI_RESCHEDULE);
+
+  smp_parallel_work(job);
+  while (__atomic_load_n(&job->done, __ATOMIC_ACQUIRE) != count)
+    cpu_relax();
+
+   
+   
+  __atomic_store_n(&job->running, 0, __ATOMIC_RELEASE);
+  while (__atomic_load_n(&job->active, __ATOMIC_ACQUIRE))
+    cpu_relax();
+}
+
+void smp_tlb_flush_all(void) {
+  __asm__ volatile("dsb ishst\n"
+                   "tlbi vmalle1is\n"
+                   "dsb ish\n"
+                   "isb" ::: "memory");
+}
+
+void smp_tlb_flush_page(uint64_t va) {
+  __asm__ volatile("dsb ishst\n"
+                   "tlbi vaae1is, %0\n"
+                   "dsb ish\n"
+                   "isb" ::"r"(va >> 12)
+                   : "memory");
+}
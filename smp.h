@@ -0,0 +1,51 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include <stdint.h>
+
+#define MAX_CPUS 64
+
+#define IPI_RESCHEDULE 0
+#define IPI_CALL_FUNC 1
+
+typedef void (*smp_call_func_t)(void *info);
+typedef void (*smp_parallel_func_t)(void *info, uint32_t index);
+
+struct smp_call {
+  struct smp_call *next;
+  smp_call_func_t func;
+  void *info;
+  uint32_t flags;
+};
+
+static inline uint32_t smp_processor_id(void) {
+  uint64_t id;
+  __asm__ volatile("mrs %0, tpidr_el1" : "=r"(id));
+  return (uint32_t)id;
+}
+
+static inline void smp_set_processor_id(uint32_t id) {
+  __asm__ volatile("msr tpidr_el1, %0" ::"r"((uint64_t)id));
+}
+
+void smp_init(void);
+uint32_t smp_num_cpus(void);
+int smp_cpu_online(uint32_t cpu);
+
+void smp_send_reschedule(uint32_t cpu);
+int smp_need_resched(void);
+
+int smp_call_function_single(uint32_t cpu, smp_call_func_t func, void *info,
+                             int wait);
+void smp_call_function(smp_call_func_t func, void *info, int wait);
+
+ 
+ 
+ 
+void smp_parallel_for(smp_parallel_func_t func, void *info, uint32_t count,
+                      uint32_t max_cpus);
+
+void smp_tlb_flush_all(void);
+void smp_tlb_flush_page(uint64_t va);
+
+#endif
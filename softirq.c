@@ -0,0 +1,101 @@
+#include "softirq.h"
+#include "irq.h"
+#include "smp.h"
+#include <stddef.h>
+
+#define SOFTIRQ_MAX_RESTART 10
+#define TASKLET_STATE_SCHED 1
+
+struct softirq_cpu {
+  uint32_t pending;
+  int active;
+  struct tasklet *tasklet_head;
+  struct tasklet **tasklet_tail;
+} __attribute__((aligned(64)));
+
+static softirq_handler_t softirq_handlers[NR_SOFTIRQS];
+static struct softirq_cpu softirq_cpus[MAX_CPUS];
+
+static void tasklet_action(void) {
+  struct softirq_cpu *sc = &softirq_cpus[smp_processor_id()];
+
+  uint64_t flags = local_irq_save();
+  struct tasklet *list = sc->tasklet_head;
+  sc->tasklet_head = NULL;
+  sc->tasklet_tail = &sc->tasklet_head;
+  local_irq_restore(flags);
+
+  while (list) {
+    struct tasklet *t = list;
+    list = t->next;
+    __atomic_and_fetch(&t->state, ~TASKLET_STATE_SCHED, __ATOMIC_ACQ_REL);
+    t->func(t->data);
+  }
+}
+
+void softirq_init(void) {
+  for (int i = 0; i < MAX_CPUS; i++) {
+    softirq_cpus[i].pending = 0;
+    softirq_cpus[i].active = 0;
+    softirq_cpus[i].tasklet_head = NULL;
+    softirq_cpus[i].tasklet_tail = &softirq_cpus[i].tasklet_head;
+  }
+  open_softirq(SOFTIRQ_TASKLET, tasklet_action);
+}
+
+void open_softirq(uint32_t nr, softirq_handler_t handler) {
+  if (nr < NR_SOFTIRQS)
+    softirq_handlers[nr] = handler;
+}
+
+void raise_softirq(uint32_t nr) {
+  if (nr >= NR_SOFTIRQS)
+    return;
+  __atomic_or_fetch(&softirq_cpus[smp_processor_id()].pending, 1u << nr,
+                    __ATOMIC_RELEASE);
+}
+
+void do_softirq(void) {
+  struct softirq_cpu *sc = &softirq_cpus[smp_processor_id()];
+
+  if (sc->active)
+    return;
+  sc->active = 1;
+
+  for (int restart = 0; restart < SOFTIRQ_MAX_RESTART; restart++) {
+    uint32_t pending = __atomic_exchange_n(&sc->pending, 0, __ATOMIC_ACQ_REL);
+    if (!pending)
+      break;
+
+    local_irq_enable();
+    for (uint32_t nr = 0; nr < NR_SOFTIRQS; nr++) {
+      if ((pending & (1u << nr)) && softirq_handlers[nr])
+        softirq_handlers[nr]();
+    }
+    local_irq_disable();
+  }
+
+  sc->active = 0;
+}
+
+void tasklet_init(struct tasklet *t, void (*func)(void *data), void *data) {
+  t->next = NULL;
+  t->func = func;
+  t->data = data;
+  t->state = 0;
+}
+
+void tasklet_schedule(struct tasklet *t) {
+  if (__atomic_fetch_or(&t->state, TASKLET_STATE_SCHED, __ATOMIC_ACQ_REL) &
+      TASKLET_STATE_SCHED)
+    return;
+
+  struct softirq_cpu *sc = &softirq_cpus[smp_processor_id()];
+  uint64_t flags = local_irq_save();
+  t->next = NULL;
+  *sc->tasklet_tail = t;
+  sc->tasklet_tail = &t->next;
+  local_irq_restore(flags);
+
+  raise_softirq(SOFTIRQ_TASKLET);
+}
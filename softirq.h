@@ -0,0 +1,29 @@
+#ifndef SOFTIRQ_H
+#define SOFTIRQ_H
+
+#include <stdint.h>
+
+enum {
+  SOFTIRQ_TIMER,
+  SOFTIRQ_TASKLET,
+  NR_SOFTIRQS,
+};
+
+typedef void (*softirq_handler_t)(void);
+
+struct tasklet {
+  struct tasklet *next;
+  void (*func)(void *data);
+  void *data;
+  uint32_t state;
+};
+
+void softirq_init(void);
+void open_softirq(uint32_t nr, softirq_handler_t handler);
+void raise_softirq(uint32_t nr);
+void do_softirq(void);
+
+void tasklet_init(struct tasklet *t, void (*func)(void *data), void *data);
+void tasklet_schedule(struct tasklet *t);
+
+#endif
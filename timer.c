@@ -1,15 +1,14 @@
 #include "timer.h"
-#include "console.h"
 #include "gic.h"
+#include "irq.h"
+#include "printk.h"
+#include "softirq.h"
+#include <stddef.h>
 
 static uint64_t timer_interval = 0;
-
- 
-static inline uint64_t read_cntfrq(void) {
-  uint64_t val;
-  __asm__ volatile("mrs %0, cntfrq_el0" : "=r"(val));
-  return val;
-}
+static int timer_registered = 0;
+static volatile uint64_t timer_jiffies = 0;
+static timer_tick_t timer_ticks[TIMER_MAX_TICK_HANDLERS];
 
  
 static inline void write_cntv_tval(uint64_t val) {
@@ -21,15 +20,30 @@ static inline void write_cntv_ctl(uint64_t val) {
   __asm__ volatile("msr cntv_ctl_el0, %0" ::"r"(val));
 }
 
-void timer_init(uint64_t interval_ms) {
-   
-  uint64_t freq = read_cntfrq();
-  console_print("TIMER: Frequency = ");
-  console_print_dec(freq / 1000000);
-  console_print(" MHz\n");
+static void timer_interrupt(uint32_t irq, void *ctx) {
+  (void)irq;
+  (void)ctx;
+  if (!timer_interval) {
+    write_cntv_ctl(0);
+    return;
+  }
+  write_cntv_tval(timer_interval);
+  raise_softirq(SOFTIRQ_TIMER);
+}
 
-   
-  timer_interval = (freq * interval_ms) / 1000;
+ 
+ 
+static void timer_softirq(void) {
+  timer_jiffies++;
+  for (int i = 0; i < TIMER_MAX_TICK_HANDLERS; i++) {
+    timer_tick_t fn = timer_ticks[i];
+    if (fn)
+      fn();
+  }
+}
+
+static void timer_start(uint64_t interval) {
+  timer_interval = interval;
 
    
   write_cntv_tval(timer_interval);
@@ -38,12 +52,53 @@ void timer_init(uint64_t interval_ms) {
   write_cntv_ctl(1);
 
    
-  gic_enable_irq(TIMER_IRQ);
+  if (!timer_registered) {
+    open_softirq(SOFTIRQ_TIMER, timer_softirq);
+    irq_register(TIMER_IRQ, timer_interrupt, NULL);
+    timer_registered = 1;
+  }
+}
+
+void timer_init(uint64_t interval_ms) {
+   
+  uint64_t freq = timer_frequency();
+  printk(PRINTK_INFO, "TIMER: Frequency = %lu MHz\n", freq / 1000000);
+
+  timer_start((freq * interval_ms) / 1000);
 
-  console_print("TIMER: Initialized (");
-  console_print_dec(interval_ms);
-  console_print("ms interval).\n");
+  printk(PRINTK_INFO, "TIMER: Initialized (%lums interval).\n", interval_ms);
 }
 
  
-void timer_reload(void) { write_cntv_tval(timer_interval); }
+ 
+void timer_set_rate(uint32_t hz) {
+  if (!hz) {
+    timer_interval = 0;
+    write_cntv_ctl(0);
+    return;
+  }
+  timer_start(timer_frequency() / hz);
+}
+
+uint64_t timer_get_jiffies(void) { return timer_jiffies; }
+
+int timer_register_tick(timer_tick_t fn) {
+  for (int i = 0; i < TIMER_MAX_TICK_HANDLERS; i++) {
+    if (timer_ticks[i] == fn)
+      return 0;
+  }
+  for (int i = 0; i < TIMER_MAX_TICK_HANDLERS; i++) {
+    if (!timer_ticks[i]) {
+      timer_ticks[i] = fn;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+void timer_unregister_tick(timer_tick_t fn) {
+  for (int i = 0; i < TIMER_MAX_TICK_HANDLERS; i++) {
+    if (timer_ticks[i] == fn)
+      timer_ticks[i] = NULL;
+  }
+}
@@ -3,6 +3,42 @@
 
 #include <stdint.h>
 
+#define TIMER_MAX_TICK_HANDLERS 4
+
+typedef void (*timer_tick_t)(void);
+
 void timer_init(uint64_t interval_ms);
 
-#endif  
+ 
+ 
+void timer_set_rate(uint32_t hz);
+uint64_t timer_get_jiffies(void);
+
+ 
+ 
+int timer_register_tick(timer_tick_t fn);
+void timer_unregister_tick(timer_tick_t fn);
+
+static inline uint64_t timer_read_counter(void) {
+  uint64_t val;
+  __asm__ volatile("isb\n"
+                   "mrs %0, cntvct_el0"
+                   : "=r"(val)
+                   :
+                   : "memory");
+  return val;
+}
+
+static inline uint64_t timer_frequency(void) {
+  uint64_t val;
+  __asm__ volatile("mrs %0, cntfrq_el0" : "=r"(val));
+  return val;
+}
+
+static inline uint64_t timer_ticks_to_ns(uint64_t ticks) {
+  uint64_t freq = timer_frequency();
+  return (ticks / freq) * 1000000000ull +
+         (ticks % freq) * 1000000000ull / freq;
+}
+
+#endif
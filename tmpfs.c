@@ -10,6 +10,7 @@ static uint64_t tmpfs_write(fs_node_t *node, uint64_t offset, uint64_t size,
                             uint8_t *buffer);
 static struct dirent *tmpfs_readdir(fs_node_t *node, uint32_t index);
 static fs_node_t *tmpfs_finddir(fs_node_t *node, char *name);
+static int tmpfs_unlink(fs_node_t *node, char *name);
 
  
 fs_node_t *tmpfs_create_file(fs_node_t *parent, char *name);
@@ -29,6 +30,7 @@ static fs_node_t *create_node(char *name, uint32_t flags) {
   node->finddir = tmpfs_finddir;
   node->create = tmpfs_create_file;
   node->mkdir = tmpfs_create_dir;
+  node->unlink = tmpfs_unlink;
   return node;
 }
 
@@ -43,7 +45,7 @@ fs_node_t *tmpfs_create_file(fs_node_t *parent, char *name) {
   if (parent) {
      
     node->next = parent->ptr;
-    parent->ptr = node;
+    rcu_assign_pointer(parent->ptr, node);
   }
   return node;
 }
@@ -55,7 +57,7 @@ fs_node_t *tmpfs_create_dir(fs_node_t *parent, char *name) {
 
   if (parent) {
     node->next = parent->ptr;
-    parent->ptr = node;
+    rcu_assign_pointer(parent->ptr, node);
   }
   return node;
 }
@@ -115,17 +117,20 @@ static struct dirent *tmpfs_readdir(fs_node_t *node, uint32_t index) {
     return NULL;
 
    
-  fs_node_t *child = (fs_node_t *)node->ptr;
+  rcu_read_lock();
+  fs_node_t *child = rcu_dereference(node->ptr);
   uint32_t i = 0;
   while (child != NULL) {
     if (i == index) {
       k_strcpy(dir_entry.name, child->name);
       dir_entry.inode = 0;
+      rcu_read_unlock();
       return &dir_entry;
     }
-    child = child->next;
+    child = rcu_dereference(child->next);
     i++;
   }
+  rcu_read_unlock();
   return NULL;
 }
 
@@ -133,11 +138,38 @@ static fs_node_t *tmpfs_finddir(fs_node_t *node, char *name) {
   if ((node->flags & 0x7) != FS_DIRECTORY)
     return NULL;
 
-  fs_node_t *child = (fs_node_t *)node->ptr;
+  rcu_read_lock();
+  fs_node_t *child = rcu_dereference(node->ptr);
   while (child != NULL) {
     if (k_strcmp(name, child->name) == 0)
-      return child;
-    child = child->next;
+      break;
+    child = rcu_dereference(child->next);
   }
-  return NULL;
+  rcu_read_unlock();
+  return child;
+}
+
+static void tmpfs_free_node(struct rcu_head *head) {
+  fs_node_t *node = container_of(head, fs_node_t, rcu);
+  if ((node->flags & 0x7) == FS_FILE && node->ptr)
+    free(node->ptr);
+  free(node);
+}
+
+static int tmpfs_unlink(fs_node_t *node, char *name) {
+  if ((node->flags & 0x7) != FS_DIRECTORY)
+    return -1;
+
+  fs_node_t **link = &node->ptr;
+  fs_node_t *child = *link;
+  while (child != NULL) {
+    if (k_strcmp(name, child->name) == 0) {
+      rcu_assign_pointer(*link, child->next);
+      call_rcu(&child->rcu, tmpfs_free_node);
+      return 0;
+    }
+    link = &child->next;
+    child = *link;
+  }
+  return -1;
 }
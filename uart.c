@@ -1,17 +1,45 @@
 #include "uart.h"
+#include "console.h"
+#include "irq.h"
+#include "process.h"
+#include <stddef.h>
 
 static uint64_t uart_base = UART0_PHYS;  
+static int uart_irq_mode = 0;
+static uint32_t uart_imsc = 0;
 
  
+ 
+ 
+ 
+ 
+static char tx_ring[UART_TX_RING];
+static uint32_t tx_head = 0;
+static uint32_t tx_tail = 0;
+static uint32_t tx_busy = 0;
+
+static char rx_ring[UART_RX_RING];
+static uint32_t rx_head = 0;
+static uint32_t rx_tail = 0;
+static task_t *rx_waiter = NULL;
+
+static struct {
+  uint64_t tx_bytes;
+  uint64_t tx_dropped;
+  uint64_t rx_bytes;
+  uint64_t rx_dropped;
+  uint64_t irqs;
+} stats;
+
+ 
+ 
+ 
 static inline void mmio_write(uint64_t reg, uint32_t val) {
   *(volatile uint32_t *)reg = val;
-  __asm__ volatile("dmb sy" ::: "memory");
 }
 
 static inline uint32_t mmio_read(uint64_t reg) {
-  uint32_t val = *(volatile uint32_t *)reg;
-  __asm__ volatile("dmb sy" ::: "memory");
-  return val;
+  return *(volatile uint32_t *)reg;
 }
 
 void uart_init(uint64_t vbase) {
@@ -31,23 +59,208 @@ void uart_init(uint64_t vbase) {
   mmio_write(uart_base + UART_LCRH, (3 << 5) | (1 << 4));
 
    
+  mmio_write(uart_base + UART_IFLS, UART_IFLS_TX_1_8 | UART_IFLS_RX_1_2);
+
+   
   mmio_write(uart_base + UART_CR, (1 << 0) | (1 << 8) | (1 << 9));
+  __asm__ volatile("dsb sy" ::: "memory");
+}
+
+static inline int uart_tx_full(void) {
+  return mmio_read(uart_base + UART_FR) & UART_FR_TXFF;
+}
+
+static inline int uart_rx_empty(void) {
+  return mmio_read(uart_base + UART_FR) & UART_FR_RXFE;
+}
+
+ 
+ 
+ 
+ 
+static void uart_tx_drain(void) {
+  for (;;) {
+    if (__atomic_exchange_n(&tx_busy, 1, __ATOMIC_ACQUIRE))
+      return;
+
+    uint32_t tail = tx_tail;
+    uint32_t head = __atomic_load_n(&tx_head, __ATOMIC_ACQUIRE);
+    while (tail != head && !uart_tx_full()) {
+      mmio_write(uart_base + UART_DR,
+                 (uint8_t)tx_ring[tail % UART_TX_RING]);
+      tail++;
+    }
+    __atomic_store_n(&tx_tail, tail, __ATOMIC_RELEASE);
+
+    uint32_t imsc = tail != head ? (uart_imsc | UART_INT_TX)
+                                 : (uart_imsc & ~UART_INT_TX);
+    if (imsc != uart_imsc) {
+      uart_imsc = imsc;
+      mmio_write(uart_base + UART_IMSC, imsc);
+    }
+    __atomic_store_n(&tx_busy, 0, __ATOMIC_RELEASE);
+
+     
+     
+    if (tail == __atomic_load_n(&tx_head, __ATOMIC_ACQUIRE) ||
+        (imsc & UART_INT_TX))
+      return;
+  }
+}
+
+static void uart_rx_fill(void) {
+  uint32_t head = rx_head;
+  while (!uart_rx_empty()) {
+    char c = (char)(mmio_read(uart_base + UART_DR) & 0xFF);
+    if (head - __atomic_load_n(&rx_tail, __ATOMIC_ACQUIRE) >= UART_RX_RING) {
+      stats.rx_dropped++;
+      continue;
+    }
+    rx_ring[head % UART_RX_RING] = c;
+    head++;
+    stats.rx_bytes++;
+  }
+  __atomic_store_n(&rx_head, head, __ATOMIC_RELEASE);
+}
+
+static void uart_interrupt(uint32_t irq, void *ctx) {
+  (void)irq;
+  (void)ctx;
+  stats.irqs++;
+
+  uint32_t mis = mmio_read(uart_base + UART_MIS);
+  mmio_write(uart_base + UART_ICR, mis);
+
+  if (mis & (UART_INT_RX | UART_INT_RT)) {
+    uart_rx_fill();
+    task_t *waiter = rx_waiter;
+    if (waiter) {
+      rx_waiter = NULL;
+      process_wake(waiter);
+    }
+  }
+  if (mis & UART_INT_TX)
+    uart_tx_drain();
+}
+
+void uart_irq_init(void) {
+  if (uart_irq_mode)
+    return;
+  if (irq_register(UART0_IRQ, uart_interrupt, NULL) != 0)
+    return;
+
+  uint64_t flags = local_irq_save();
+  mmio_write(uart_base + UART_ICR, 0x7FF);
+  uart_imsc = UART_INT_RX | UART_INT_RT;
+  mmio_write(uart_base + UART_IMSC, uart_imsc);
+  uart_irq_mode = 1;
+  uart_rx_fill();
+  local_irq_restore(flags);
 }
 
 int uart_has_char(void) {
-  return !(mmio_read(uart_base + UART_FR) & UART_FR_RXFE);
+  if (!uart_irq_mode)
+    return !uart_rx_empty();
+  return __atomic_load_n(&rx_head, __ATOMIC_ACQUIRE) != rx_tail;
 }
 
 char uart_getc(void) {
-  while (!uart_has_char()) {
-    __asm__ volatile("yield");
+  if (!uart_irq_mode) {
+    while (uart_rx_empty()) {
+      __asm__ volatile("yield");
+    }
+    return (char)(mmio_read(uart_base + UART_DR) & 0xFF);
+  }
+
+  for (;;) {
+    uint64_t flags = local_irq_save();
+    uint32_t tail = rx_tail;
+    if (__atomic_load_n(&rx_head, __ATOMIC_ACQUIRE) != tail) {
+      char c = rx_ring[tail % UART_RX_RING];
+      __atomic_store_n(&rx_tail, tail + 1, __ATOMIC_RELEASE);
+      local_irq_restore(flags);
+      return c;
+    }
+
+     
+     
+     
+    if (current_task) {
+      rx_waiter = current_task;
+      current_task->state = TASK_BLOCKED;
+      local_irq_restore(flags);
+      schedule();
+      flags = local_irq_save();
+      if (current_task->state == TASK_BLOCKED &&
+          __atomic_load_n(&rx_head, __ATOMIC_ACQUIRE) == rx_tail)
+        __asm__ volatile("wfi");
+      current_task->state = TASK_RUNNING;
+      rx_waiter = NULL;
+    } else {
+      __asm__ volatile("wfi");
+    }
+    local_irq_restore(flags);
   }
-  return (char)(mmio_read(uart_base + UART_DR) & 0xFF);
 }
 
-void uart_putc(char c) {
-  while (mmio_read(uart_base + UART_FR) & UART_FR_TXFF) {
+void uart_putc_sync(char c) {
+  while (uart_tx_full()) {
     __asm__ volatile("yield");
   }
-  mmio_write(uart_base + UART_DR, (uint32_t)c);
+  mmio_write(uart_base + UART_DR, (uint8_t)c);
+}
+
+void uart_write(const char *buf, size_t len) {
+  if (!uart_irq_mode) {
+    for (size_t i = 0; i < len; i++)
+      uart_putc_sync(buf[i]);
+    return;
+  }
+
+  uint64_t flags = local_irq_save();
+  uint32_t head = tx_head;
+  uint32_t tail = __atomic_load_n(&tx_tail, __ATOMIC_ACQUIRE);
+  size_t room = UART_TX_RING - (head - tail);
+  size_t n = len < room ? len : room;
+  for (size_t i = 0; i < n; i++)
+    tx_ring[(head + i) % UART_TX_RING] = buf[i];
+  __atomic_store_n(&tx_head, head + (uint32_t)n, __ATOMIC_RELEASE);
+  stats.tx_bytes += n;
+  stats.tx_dropped += len - n;
+  uart_tx_drain();
+  local_irq_restore(flags);
+}
+
+void uart_putc(char c) { uart_write(&c, 1); }
+
+void uart_flush(void) {
+  if (!uart_irq_mode)
+    return;
+  if (__atomic_exchange_n(&tx_busy, 1, __ATOMIC_ACQUIRE))
+    return;
+  uint32_t tail = tx_tail;
+  uint32_t head = __atomic_load_n(&tx_head, __ATOMIC_ACQUIRE);
+  while (tail != head)
+    uart_putc_sync(tx_ring[tail++ % UART_TX_RING]);
+  __atomic_store_n(&tx_tail, tail, __ATOMIC_RELEASE);
+  __atomic_store_n(&tx_busy, 0, __ATOMIC_RELEASE);
+}
+
+void uart_print_stats(void) {
+  console_print("UART mode: ");
+  console_print(uart_irq_mode ? "interrupt" : "polled");
+  console_print("\nTX bytes: ");
+  console_print_dec(stats.tx_bytes);
+  console_print(" (dropped ");
+  console_print_dec(stats.tx_dropped);
+  console_print(", queued ");
+  console_print_dec(__atomic_load_n(&tx_head, __ATOMIC_RELAXED) -
+                    __atomic_load_n(&tx_tail, __ATOMIC_RELAXED));
+  console_print(")\nRX bytes: ");
+  console_print_dec(stats.rx_bytes);
+  console_print(" (dropped ");
+  console_print_dec(stats.rx_dropped);
+  console_print(")\nIRQs: ");
+  console_print_dec(stats.irqs);
+  console_print("\n");
 }
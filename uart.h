@@ -1,10 +1,12 @@
 #ifndef UART_H
 #define UART_H
 
+#include <stddef.h>
 #include <stdint.h>
 
  
 #define UART0_PHYS 0x09000000
+#define UART0_IRQ 33
 
  
 #define UART_DR 0x00    
@@ -13,22 +15,57 @@
 #define UART_FBRD 0x28  
 #define UART_LCRH 0x2C  
 #define UART_CR 0x30    
+#define UART_IFLS 0x34  
 #define UART_IMSC 0x38  
+#define UART_MIS 0x40   
+#define UART_ICR 0x44   
 
  
 #define UART_FR_RXFE (1 << 4)  
 #define UART_FR_TXFF (1 << 5)  
 
  
+#define UART_INT_RX (1 << 4)
+#define UART_INT_TX (1 << 5)
+#define UART_INT_RT (1 << 6)
+
+ 
+#define UART_IFLS_TX_1_8 (0 << 0)
+#define UART_IFLS_RX_1_2 (2 << 3)
+
+ 
+ 
+#define UART_TX_RING 4096
+#define UART_RX_RING 256
+
+ 
 void uart_init(uint64_t vbase);
 
  
+ 
+ 
+void uart_irq_init(void);
+
+ 
+ 
+ 
 char uart_getc(void);
 
  
 int uart_has_char(void);
 
  
+ 
+ 
 void uart_putc(char c);
+void uart_write(const char *buf, size_t len);
+
+ 
+ 
+ 
+void uart_putc_sync(char c);
+void uart_flush(void);
+
+void uart_print_stats(void);
 
 #endif  
@@ -49,3 +49,9 @@ fs_node_t *vfs_mkdir(fs_node_t *node, char *name) {
     return node->mkdir(node, name);
   return NULL;
 }
+
+int vfs_unlink(fs_node_t *node, char *name) {
+  if ((node->flags & 0x7) == FS_DIRECTORY && node->unlink)
+    return node->unlink(node, name);
+  return -1;
+}
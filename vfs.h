@@ -1,6 +1,7 @@
 #ifndef VFS_H
 #define VFS_H
 
+#include "rcu.h"
 #include <stddef.h>
 #include <stdint.h>
 
@@ -25,6 +26,7 @@ typedef struct dirent *(*readdir_type_t)(struct fs_node *, uint32_t);
 typedef struct fs_node *(*finddir_type_t)(struct fs_node *, char *name);
 typedef struct fs_node *(*create_type_t)(struct fs_node *, char *name);
 typedef struct fs_node *(*mkdir_type_t)(struct fs_node *, char *name);
+typedef int (*unlink_type_t)(struct fs_node *, char *name);
 
 typedef struct fs_node {
   char name[128];
@@ -39,8 +41,10 @@ typedef struct fs_node {
   finddir_type_t finddir;
   create_type_t create;
   mkdir_type_t mkdir;
+  unlink_type_t unlink;
   struct fs_node *ptr;   
   struct fs_node *next;  
+  struct rcu_head rcu;
 } fs_node_t;
 
 struct dirent {
@@ -62,5 +66,6 @@ struct dirent *vfs_readdir(fs_node_t *node, uint32_t index);
 fs_node_t *vfs_finddir(fs_node_t *node, char *name);
 fs_node_t *vfs_create(fs_node_t *node, char *name);
 fs_node_t *vfs_mkdir(fs_node_t *node, char *name);
+int vfs_unlink(fs_node_t *node, char *name);
 
 #endif  
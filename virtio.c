@@ -18,7 +18,8 @@ static inline void virtio_write8(uint64_t base, uint32_t offset, uint8_t val) {
 
 uint64_t virtio_find_device(uint32_t device_id, uint64_t hhdm_offset) {
   for (uint64_t i = 0; i < 32; i++) {
-    uint64_t base = 0x0a000000 + (i * 0x200) + hhdm_offset;
+    uint64_t base =
+        VIRTIO_MMIO_BASE + (i * VIRTIO_MMIO_STRIDE) + hhdm_offset;
 
     uint32_t magic = virtio_read32(base, VIRTIO_MMIO_MAGIC_VALUE);
     uint32_t dev_id = virtio_read32(base, VIRTIO_MMIO_DEVICE_ID);
@@ -45,7 +46,8 @@ static int virtio_input_supports_event(uint64_t base, uint8_t ev_type) {
 
 uint64_t virtio_find_input_device(uint64_t hhdm_offset, int want_tablet) {
   for (uint64_t i = 0; i < 32; i++) {
-    uint64_t base = 0x0a000000 + (i * 0x200) + hhdm_offset;
+    uint64_t base =
+        VIRTIO_MMIO_BASE + (i * VIRTIO_MMIO_STRIDE) + hhdm_offset;
     uint32_t magic = virtio_read32(base, VIRTIO_MMIO_MAGIC_VALUE);
     uint32_t dev_id = virtio_read32(base, VIRTIO_MMIO_DEVICE_ID);
     if (magic == 0x74726976 && dev_id == VIRTIO_ID_INPUT) {
@@ -61,3 +63,9 @@ uint64_t virtio_find_input_device(uint64_t hhdm_offset, int want_tablet) {
   }
   return 0;
 }
+
+uint32_t virtio_mmio_irq(uint64_t base, uint64_t hhdm_offset) {
+  return VIRTIO_MMIO_IRQ_BASE +
+         (uint32_t)((base - hhdm_offset - VIRTIO_MMIO_BASE) /
+                    VIRTIO_MMIO_STRIDE);
+}
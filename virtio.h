@@ -29,7 +29,12 @@
 #define VIRTIO_MMIO_CONFIG_GENERATION 0x0fc
 #define VIRTIO_MMIO_CONFIG 0x100
 
+#define VIRTIO_MMIO_BASE 0x0a000000
+#define VIRTIO_MMIO_STRIDE 0x200
+#define VIRTIO_MMIO_IRQ_BASE 48
+
  
+#define VIRTIO_ID_GPU 16
 #define VIRTIO_ID_INPUT 18
 
  
@@ -67,4 +72,50 @@ struct virtq_used {
   struct virtq_used_elem ring[];
 } __attribute__((packed));
 
+struct virtio_input_event {
+  uint16_t type;
+  uint16_t code;
+  uint32_t value;
+};
+
+#define VIRTIO_INPUT_QUEUE_LEN 64
+
+struct virtio_input_queue {
+  uint32_t head;
+  uint32_t tail;
+  struct virtio_input_event ev[VIRTIO_INPUT_QUEUE_LEN];
+};
+
+static inline int
+virtio_input_queue_push(struct virtio_input_queue *q,
+                        const volatile struct virtio_input_event *ev) {
+  uint32_t head = q->head;
+  uint32_t tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+  if (head - tail >= VIRTIO_INPUT_QUEUE_LEN)
+    return 0;
+  struct virtio_input_event *slot = &q->ev[head % VIRTIO_INPUT_QUEUE_LEN];
+  slot->type = ev->type;
+  slot->code = ev->code;
+  slot->value = ev->value;
+  __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+  return 1;
+}
+
+static inline int virtio_input_queue_pop(struct virtio_input_queue *q,
+                                         struct virtio_input_event *ev) {
+  uint32_t tail = q->tail;
+  if (tail == __atomic_load_n(&q->head, __ATOMIC_ACQUIRE))
+    return 0;
+  *ev = q->ev[tail % VIRTIO_INPUT_QUEUE_LEN];
+  __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+  return 1;
+}
+
+static inline int virtio_input_queue_empty(struct virtio_input_queue *q) {
+  return q->tail == __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+}
+
+uint64_t virtio_find_device(uint32_t device_id, uint64_t hhdm_offset);
+uint32_t virtio_mmio_irq(uint64_t base, uint64_t hhdm_offset);
+
 #endif  
@@ -0,0 +1,530 @@
+#include "virtio_gpu.h"
+#include "console.h"
+#include "string.h"
+#include "virtio.h"
+#include <stddef.h>
+
+#define PAGE_SIZE 4096
+#define CTRL_QUEUE 0
+#define CTRL_QUEUE_SIZE 256
+#define CURSOR_QUEUE 1
+#define CURSOR_QUEUE_SIZE 16
+#define SLOT_COMMANDS (CTRL_QUEUE_SIZE / VIRTIO_GPU_MAX_SLOTS / 2)
+
+#define VIRTIO_MMIO_GUEST_PAGE_SIZE 0x028
+#define VIRTIO_MMIO_QUEUE_ALIGN 0x03c
+#define VIRTIO_MMIO_QUEUE_PFN 0x040
+
+#define VIRTQ_AVAIL_F_NO_INTERRUPT 1
+
+#define VIRTIO_GPU_CMD_GET_DISPLAY_INFO 0x0100
+#define VIRTIO_GPU_CMD_RESOURCE_CREATE_2D 0x0101
+#define VIRTIO_GPU_CMD_SET_SCANOUT 0x0103
+#define VIRTIO_GPU_CMD_RESOURCE_FLUSH 0x0104
+#define VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D 0x0105
+#define VIRTIO_GPU_CMD_RESOURCE_ATTACH_BACKING 0x0106
+#define VIRTIO_GPU_CMD_UPDATE_CURSOR 0x0300
+#define VIRTIO_GPU_CMD_MOVE_CURSOR 0x0301
+
+#define VIRTIO_GPU_RESP_OK_NODATA 0x1100
+#define VIRTIO_GPU_RESP_OK_DISPLAY_INFO 0x1101
+
+#define VIRTIO_GPU_FORMAT_B8G8R8A8_UNORM 1
+#define VIRTIO_GPU_FORMAT_B8G8R8X8_UNORM 2
+#define VIRTIO_GPU_MAX_SCANOUTS 16
+#define VIRTIO_GPU_CURSOR_RESOURCE 0x100
+
+struct virtio_gpu_ctrl_hdr {
+  uint32_t type;
+  uint32_t flags;
+  uint64_t fence_id;
+  uint32_t ctx_id;
+  uint32_t padding;
+} __attribute__((packed));
+
+struct virtio_gpu_rect {
+  uint32_t x;
+  uint32_t y;
+  uint32_t width;
+  uint32_t height;
+} __attribute__((packed));
+
+struct virtio_gpu_resp_display_info {
+  struct virtio_gpu_ctrl_hdr hdr;
+  struct {
+    struct virtio_gpu_rect r;
+    uint32_t enabled;
+    uint32_t flags;
+  } pmodes[VIRTIO_GPU_MAX_SCANOUTS];
+} __attribute__((packed));
+
+struct virtio_gpu_resource_create_2d {
+  struct virtio_gpu_ctrl_hdr hdr;
+  uint32_t resource_id;
+  uint32_t format;
+  uint32_t width;
+  uint32_t height;
+} __attribute__((packed));
+
+struct virtio_gpu_resource_attach_backing {
+  struct virtio_gpu_ctrl_hdr hdr;
+  uint32_t resource_id;
+  uint32_t nr_entries;
+  uint64_t addr;
+  uint32_t length;
+  uint32_t padding;
+} __attribute__((packed));
+
+struct virtio_gpu_set_scanout {
+  struct virtio_gpu_ctrl_hdr hdr;
+  struct virtio_gpu_rect r;
+  uint32_t scanout_id;
+  uint32_t resource_id;
+} __attribute__((packed));
+
+struct virtio_gpu_resource_flush {
+  struct virtio_gpu_ctrl_hdr hdr;
+  struct virtio_gpu_rect r;
+  uint32_t resource_id;
+  uint32_t padding;
+} __attribute__((packed));
+
+struct virtio_gpu_transfer_to_host_2d {
+  struct virtio_gpu_ctrl_hdr hdr;
+  struct virtio_gpu_rect r;
+  uint64_t offset;
+  uint32_t resource_id;
+  uint32_t padding;
+} __attribute__((packed));
+
+struct virtio_gpu_update_cursor {
+  struct virtio_gpu_ctrl_hdr hdr;
+  uint32_t scanout_id;
+  uint32_t x;
+  uint32_t y;
+  uint32_t pos_padding;
+  uint32_t resource_id;
+  uint32_t hot_x;
+  uint32_t hot_y;
+  uint32_t padding;
+} __attribute__((packed));
+
+ 
+ 
+union gpu_command {
+  struct virtio_gpu_ctrl_hdr hdr;
+  struct virtio_gpu_resource_create_2d create;
+  struct virtio_gpu_resource_attach_backing attach;
+  struct virtio_gpu_set_scanout scanout;
+  struct virtio_gpu_resource_flush flush;
+  struct virtio_gpu_transfer_to_host_2d transfer;
+};
+
+_Static_assert(REGION_MAX_RECTS + 2 <= SLOT_COMMANDS,
+              "a full damage region does not fit one command slot");
+
+struct gpu_slot {
+  union gpu_command cmd[SLOT_COMMANDS];
+  struct virtio_gpu_ctrl_hdr resp[SLOT_COMMANDS];
+  uint32_t count;
+  uint32_t pending;
+};
+
+struct gpu_avail {
+  uint16_t flags;
+  uint16_t idx;
+  uint16_t ring[CTRL_QUEUE_SIZE];
+} __attribute__((packed));
+
+struct gpu_used {
+  uint16_t flags;
+  uint16_t idx;
+  struct virtq_used_elem ring[CTRL_QUEUE_SIZE];
+} __attribute__((packed));
+
+struct cursor_avail {
+  uint16_t flags;
+  uint16_t idx;
+  uint16_t ring[CURSOR_QUEUE_SIZE];
+} __attribute__((packed));
+
+struct cursor_used {
+  uint16_t flags;
+  uint16_t idx;
+  struct virtq_used_elem ring[CURSOR_QUEUE_SIZE];
+} __attribute__((packed));
+
+static uint8_t ctrl_vq[PAGE_SIZE * 3] __attribute__((aligned(PAGE_SIZE)));
+static volatile struct virtq_desc *ctrl_desc;
+static volatile struct gpu_avail *ctrl_avail;
+static volatile struct gpu_used *ctrl_used;
+static uint16_t ctrl_last_used = 0;
+
+static uint8_t cursor_vq[PAGE_SIZE * 2] __attribute__((aligned(PAGE_SIZE)));
+static volatile struct virtq_desc *cursor_desc;
+static volatile struct cursor_avail *cursor_avail;
+static volatile struct cursor_used *cursor_used;
+static struct virtio_gpu_update_cursor cursor_cmd[CURSOR_QUEUE_SIZE];
+
+ 
+static uint32_t cursor_pixels[VIRTIO_GPU_CURSOR_SIZE * VIRTIO_GPU_CURSOR_SIZE]
+    __attribute__((aligned(PAGE_SIZE)));
+static int cursor_created = 0;
+static uint32_t cursor_hot_x = 0;
+static uint32_t cursor_hot_y = 0;
+
+static struct gpu_slot slots[VIRTIO_GPU_MAX_SLOTS];
+static struct virtio_gpu_resp_display_info display_info;
+
+static uint64_t gpu_base = 0;
+static uint64_t vbase = 0;
+static uint64_t pbase = 0;
+static uint32_t gpu_width = 0;
+static uint32_t gpu_height = 0;
+static uint32_t scanout_resource = 0;
+static uint32_t attached_mask = 0;
+
+static uint64_t to_phys(const void *vaddr) {
+  return (uint64_t)vaddr - vbase + pbase;
+}
+
+static inline void gpu_write32(uint32_t offset, uint32_t val) {
+  *(volatile uint32_t *)(gpu_base + offset) = val;
+  __asm__ volatile("dmb sy" ::: "memory");
+}
+
+static inline uint32_t gpu_read32(uint32_t offset) {
+  return *(volatile uint32_t *)(gpu_base + offset);
+}
+
+ 
+ 
+static void gpu_reap(void) {
+  __asm__ volatile("dmb sy" ::: "memory");
+  while (ctrl_used->idx != ctrl_last_used) {
+    uint32_t id = ctrl_used->ring[ctrl_last_used % CTRL_QUEUE_SIZE].id;
+    slots[id / (SLOT_COMMANDS * 2)].pending--;
+    ctrl_last_used++;
+  }
+}
+
+static void *gpu_queue(uint32_t slot, uint32_t type, uint32_t len) {
+  struct gpu_slot *s = &slots[slot];
+  if (s->count == SLOT_COMMANDS)
+    return NULL;
+
+  uint32_t i = s->count++;
+  union gpu_command *cmd = &s->cmd[i];
+  k_memset(cmd, 0, len);
+  cmd->hdr.type = type;
+
+  uint16_t head = (uint16_t)(slot * SLOT_COMMANDS * 2 + i * 2);
+  ctrl_desc[head].addr = to_phys(cmd);
+  ctrl_desc[head].len = len;
+  ctrl_desc[head].flags = VIRTQ_DESC_F_NEXT;
+  ctrl_desc[head].next = head + 1;
+  ctrl_desc[head + 1].addr = to_phys(&s->resp[i]);
+  ctrl_desc[head + 1].len = sizeof(s->resp[i]);
+  ctrl_desc[head + 1].flags = VIRTQ_DESC_F_WRITE;
+  ctrl_desc[head + 1].next = 0;
+  return cmd;
+}
+
+ 
+ 
+static void gpu_kick(uint32_t slot) {
+  struct gpu_slot *s = &slots[slot];
+  if (!s->count)
+    return;
+
+  uint16_t idx = ctrl_avail->idx;
+  for (uint32_t i = 0; i < s->count; i++) {
+    uint16_t head = (uint16_t)(slot * SLOT_COMMANDS * 2 + i * 2);
+    ctrl_avail->ring[(uint16_t)(idx + i) % CTRL_QUEUE_SIZE] = head;
+  }
+  s->pending = s->count;
+  __asm__ volatile("dmb sy" ::: "memory");
+  ctrl_avail->idx = (uint16_t)(idx + s->count);
+  __asm__ volatile("dmb sy" ::: "memory");
+  gpu_write32(VIRTIO_MMIO_QUEUE_NOTIFY, CTRL_QUEUE);
+}
+
+void virtio_gpu_wait(uint32_t slot) {
+  if (!gpu_base || slot >= VIRTIO_GPU_MAX_SLOTS)
+    return;
+  while (slots[slot].pending) {
+    gpu_reap();
+    if (slots[slot].pending)
+      __asm__ volatile("yield");
+  }
+}
+
+static void gpu_begin(uint32_t slot) {
+  virtio_gpu_wait(slot);
+  slots[slot].count = 0;
+}
+
+static int gpu_check(uint32_t slot, uint32_t expected) {
+  for (uint32_t i = 0; i < slots[slot].count; i++) {
+    if (slots[slot].resp[i].type != expected)
+      return -1;
+  }
+  return 0;
+}
+
+static int gpu_get_display_info(void) {
+  struct gpu_slot *s = &slots[0];
+  gpu_begin(0);
+  s->count = 1;
+  k_memset(&s->cmd[0], 0, sizeof(s->cmd[0]));
+  s->cmd[0].hdr.type = VIRTIO_GPU_CMD_GET_DISPLAY_INFO;
+
+  ctrl_desc[0].addr = to_phys(&s->cmd[0]);
+  ctrl_desc[0].len = sizeof(struct virtio_gpu_ctrl_hdr);
+  ctrl_desc[0].flags = VIRTQ_DESC_F_NEXT;
+  ctrl_desc[0].next = 1;
+  ctrl_desc[1].addr = to_phys(&display_info);
+  ctrl_desc[1].len = sizeof(display_info);
+  ctrl_desc[1].flags = VIRTQ_DESC_F_WRITE;
+  ctrl_desc[1].next = 0;
+
+  gpu_kick(0);
+  virtio_gpu_wait(0);
+  if (display_info.hdr.type != VIRTIO_GPU_RESP_OK_DISPLAY_INFO)
+    return -1;
+
+  gpu_width = display_info.pmodes[0].r.width;
+  gpu_height = display_info.pmodes[0].r.height;
+  return (display_info.pmodes[0].enabled && gpu_width && gpu_height) ? 0
+                                                                     : -1;
+}
+
+static int gpu_setup_queue(uint32_t index, uint32_t size, uint8_t *mem) {
+  gpu_write32(VIRTIO_MMIO_QUEUE_SEL, index);
+  if (gpu_read32(VIRTIO_MMIO_QUEUE_NUM_MAX) < size)
+    return -1;
+  gpu_write32(VIRTIO_MMIO_QUEUE_NUM, size);
+  gpu_write32(VIRTIO_MMIO_QUEUE_ALIGN, PAGE_SIZE);
+  gpu_write32(VIRTIO_MMIO_QUEUE_PFN, (uint32_t)(to_phys(mem) / PAGE_SIZE));
+  return 0;
+}
+
+int virtio_gpu_init(uint64_t hhdm_offset, uint64_t kernel_vbase,
+                    uint64_t kernel_pbase) {
+  vbase = kernel_vbase;
+  pbase = kernel_pbase;
+  uint64_t base = virtio_find_device(VIRTIO_ID_GPU, hhdm_offset);
+  if (!base)
+    return -1;
+  gpu_base = base;
+
+  if (gpu_read32(VIRTIO_MMIO_VERSION) != 1)
+    goto fail;
+
+  gpu_write32(VIRTIO_MMIO_STATUS, 0);
+  gpu_write32(VIRTIO_MMIO_STATUS,
+              VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+  gpu_write32(VIRTIO_MMIO_DRIVER_FEATURES_SEL, 0);
+  gpu_write32(VIRTIO_MMIO_DRIVER_FEATURES, 0);
+  gpu_write32(VIRTIO_MMIO_GUEST_PAGE_SIZE, PAGE_SIZE);
+
+  if (gpu_setup_queue(CTRL_QUEUE, CTRL_QUEUE_SIZE, ctrl_vq) < 0 ||
+      gpu_setup_queue(CURSOR_QUEUE, CURSOR_QUEUE_SIZE, cursor_vq) < 0)
+    goto fail;
+
+  ctrl_desc = (struct virtq_desc *)ctrl_vq;
+  ctrl_avail = (struct gpu_avail *)(ctrl_vq + sizeof(struct virtq_desc) *
+                                                  CTRL_QUEUE_SIZE);
+  ctrl_used = (struct gpu_used *)(ctrl_vq + PAGE_SIZE * 2);
+  ctrl_avail->flags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+
+  cursor_desc = (struct virtq_desc *)cursor_vq;
+  cursor_avail = (struct cursor_avail *)(cursor_vq + sizeof(struct virtq_desc) *
+                                                         CURSOR_QUEUE_SIZE);
+  cursor_used = (struct cursor_used *)(cursor_vq + PAGE_SIZE);
+  cursor_avail->flags = VIRTQ_AVAIL_F_NO_INTERRUPT;
+
+  gpu_write32(VIRTIO_MMIO_STATUS, VIRTIO_STATUS_ACKNOWLEDGE |
+                                      VIRTIO_STATUS_DRIVER |
+                                      VIRTIO_STATUS_DRIVER_OK);
+
+  if (gpu_get_display_info() < 0)
+    goto fail;
+
+  console_print("VIRTIO-GPU: Scanout 0 at ");
+  console_print_dec(gpu_width);
+  console_print("x");
+  console_print_dec(gpu_height);
+  console_print("\n");
+  return 0;
+
+fail:
+  *(volatile uint32_t *)(base + VIRTIO_MMIO_STATUS) = VIRTIO_STATUS_FAILED;
+  gpu_base = 0;
+  return -1;
+}
+
+uint32_t virtio_gpu_width(void) { return gpu_width; }
+
+uint32_t virtio_gpu_height(void) { return gpu_height; }
+
+static int gpu_create_resource(uint32_t slot, uint32_t resource,
+                               uint32_t format, uint32_t width,
+                               uint32_t height, uint64_t phys) {
+  gpu_begin(slot);
+
+  struct virtio_gpu_resource_create_2d *create =
+      gpu_queue(slot, VIRTIO_GPU_CMD_RESOURCE_CREATE_2D, sizeof(*create));
+  create->resource_id = resource;
+  create->format = format;
+  create->width = width;
+  create->height = height;
+
+  struct virtio_gpu_resource_attach_backing *attach = gpu_queue(
+      slot, VIRTIO_GPU_CMD_RESOURCE_ATTACH_BACKING, sizeof(*attach));
+  attach->resource_id = resource;
+  attach->nr_entries = 1;
+  attach->addr = phys;
+  attach->length = width * height * 4;
+
+  gpu_kick(slot);
+  virtio_gpu_wait(slot);
+  return gpu_check(slot, VIRTIO_GPU_RESP_OK_NODATA);
+}
+
+int virtio_gpu_attach(uint32_t slot, uint64_t phys) {
+  if (!gpu_base || slot >= VIRTIO_GPU_MAX_SLOTS)
+    return -1;
+  if (attached_mask & (1u << slot))
+    return 0;
+
+  if (gpu_create_resource(slot, slot + 1, VIRTIO_GPU_FORMAT_B8G8R8X8_UNORM,
+                          gpu_width, gpu_height, phys) < 0)
+    return -1;
+  attached_mask |= 1u << slot;
+  return 0;
+}
+
+static void gpu_rect(struct virtio_gpu_rect *out, const rect_t *r) {
+  out->x = (uint32_t)r->x0;
+  out->y = (uint32_t)r->y0;
+  out->width = (uint32_t)(r->x1 - r->x0);
+  out->height = (uint32_t)(r->y1 - r->y0);
+}
+
+ 
+ 
+ 
+ 
+int virtio_gpu_present(uint32_t slot, const region_t *damage) {
+  if (!gpu_base || !(attached_mask & (1u << slot)))
+    return -1;
+
+  gpu_begin(slot);
+  uint32_t resource = slot + 1;
+  rect_t bounds = {0, 0, 0, 0};
+
+  for (int i = 0; i < damage->count; i++) {
+    const rect_t *r = &damage->rects[i];
+    struct virtio_gpu_transfer_to_host_2d *xfer = gpu_queue(
+        slot, VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D, sizeof(*xfer));
+    gpu_rect(&xfer->r, r);
+    xfer->offset = ((uint64_t)r->y0 * gpu_width + (uint64_t)r->x0) * 4;
+    xfer->resource_id = resource;
+    bounds = i ? rect_union(&bounds, r) : *r;
+  }
+
+  if (scanout_resource != resource) {
+    struct virtio_gpu_set_scanout *scanout =
+        gpu_queue(slot, VIRTIO_GPU_CMD_SET_SCANOUT, sizeof(*scanout));
+    rect_t screen = rect_make(0, 0, (int)gpu_width, (int)gpu_height);
+    gpu_rect(&scanout->r, &screen);
+    scanout->scanout_id = 0;
+    scanout->resource_id = resource;
+    scanout_resource = resource;
+    bounds = screen;
+  }
+
+  struct virtio_gpu_resource_flush *flush =
+      gpu_queue(slot, VIRTIO_GPU_CMD_RESOURCE_FLUSH, sizeof(*flush));
+  gpu_rect(&flush->r, &bounds);
+  flush->resource_id = resource;
+
+  gpu_kick(slot);
+  return 0;
+}
+
+ 
+ 
+ 
+static void cursor_submit(uint32_t type, int x, int y) {
+  __asm__ volatile("dmb sy" ::: "memory");
+  while ((uint16_t)(cursor_avail->idx - cursor_used->idx) >= CURSOR_QUEUE_SIZE)
+    __asm__ volatile("yield" ::: "memory");
+
+  uint16_t idx = cursor_avail->idx;
+  uint16_t slot = idx % CURSOR_QUEUE_SIZE;
+  struct virtio_gpu_update_cursor *cmd = &cursor_cmd[slot];
+  k_memset(cmd, 0, sizeof(*cmd));
+  cmd->hdr.type = type;
+  cmd->scanout_id = 0;
+  cmd->x = (uint32_t)(x < 0 ? 0 : x);
+  cmd->y = (uint32_t)(y < 0 ? 0 : y);
+  cmd->resource_id = cursor_created ? VIRTIO_GPU_CURSOR_RESOURCE : 0;
+  cmd->hot_x = cursor_hot_x;
+  cmd->hot_y = cursor_hot_y;
+
+  cursor_desc[slot].addr = to_phys(cmd);
+  cursor_desc[slot].len = sizeof(*cmd);
+  cursor_desc[slot].flags = 0;
+  cursor_desc[slot].next = 0;
+  cursor_avail->ring[slot] = slot;
+  __asm__ volatile("dmb sy" ::: "memory");
+  cursor_avail->idx = (uint16_t)(idx + 1);
+  __asm__ volatile("dmb sy" ::: "memory");
+  gpu_write32(VIRTIO_MMIO_QUEUE_NOTIFY, CURSOR_QUEUE);
+}
+
+int virtio_gpu_cursor_set(const uint32_t *argb, int width, int height,
+                          int hot_x, int hot_y, int x, int y) {
+  if (!gpu_base || width > VIRTIO_GPU_CURSOR_SIZE ||
+      height > VIRTIO_GPU_CURSOR_SIZE)
+    return -1;
+
+  k_memset(cursor_pixels, 0, sizeof(cursor_pixels));
+  for (int row = 0; row < height; row++) {
+    for (int col = 0; col < width; col++)
+      cursor_pixels[row * VIRTIO_GPU_CURSOR_SIZE + col] =
+          argb[row * width + col];
+  }
+
+  if (!cursor_created) {
+    if (gpu_create_resource(0, VIRTIO_GPU_CURSOR_RESOURCE,
+                            VIRTIO_GPU_FORMAT_B8G8R8A8_UNORM,
+                            VIRTIO_GPU_CURSOR_SIZE, VIRTIO_GPU_CURSOR_SIZE,
+                            to_phys(cursor_pixels)) < 0)
+      return -1;
+    cursor_created = 1;
+  }
+
+  gpu_begin(0);
+  struct virtio_gpu_transfer_to_host_2d *xfer =
+      gpu_queue(0, VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D, sizeof(*xfer));
+  xfer->r.width = VIRTIO_GPU_CURSOR_SIZE;
+  xfer->r.height = VIRTIO_GPU_CURSOR_SIZE;
+  xfer->resource_id = VIRTIO_GPU_CURSOR_RESOURCE;
+  gpu_kick(0);
+  virtio_gpu_wait(0);
+  if (gpu_check(0, VIRTIO_GPU_RESP_OK_NODATA) < 0)
+    return -1;
+
+  cursor_hot_x = (uint32_t)hot_x;
+  cursor_hot_y = (uint32_t)hot_y;
+  cursor_submit(VIRTIO_GPU_CMD_UPDATE_CURSOR, x, y);
+  return 0;
+}
+
+void virtio_gpu_cursor_move(int x, int y) {
+  if (gpu_base && cursor_created)
+    cursor_submit(VIRTIO_GPU_CMD_MOVE_CURSOR, x, y);
+}
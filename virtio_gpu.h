@@ -0,0 +1,34 @@
+#ifndef VIRTIO_GPU_H
+#define VIRTIO_GPU_H
+
+#include "region.h"
+#include <stdint.h>
+
+#define VIRTIO_GPU_MAX_SLOTS 2
+#define VIRTIO_GPU_CURSOR_SIZE 64
+
+ 
+ 
+int virtio_gpu_init(uint64_t hhdm_offset, uint64_t kernel_vbase,
+                    uint64_t kernel_pbase);
+
+uint32_t virtio_gpu_width(void);
+uint32_t virtio_gpu_height(void);
+
+ 
+ 
+int virtio_gpu_attach(uint32_t slot, uint64_t phys);
+
+ 
+ 
+ 
+int virtio_gpu_present(uint32_t slot, const region_t *damage);
+void virtio_gpu_wait(uint32_t slot);
+
+ 
+ 
+int virtio_gpu_cursor_set(const uint32_t *argb, int width, int height,
+                          int hot_x, int hot_y, int x, int y);
+void virtio_gpu_cursor_move(int x, int y);
+
+#endif
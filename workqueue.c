@@ -0,0 +1,110 @@
+#include "workqueue.h"
+#include "heap.h"
+#include "irq.h"
+#include "printk.h"
+#include <stddef.h>
+
+#define MAX_WORKQUEUES 8
+
+workqueue_t *system_wq = NULL;
+
+static workqueue_t *workqueues[MAX_WORKQUEUES];
+static int workqueue_count = 0;
+
+static workqueue_t *workqueue_for_task(task_t *task) {
+  for (int i = 0; i < workqueue_count; i++) {
+    if (workqueues[i]->worker == task)
+      return workqueues[i];
+  }
+  return NULL;
+}
+
+static void worker_thread(void) {
+  workqueue_t *wq = workqueue_for_task(current_task);
+
+  for (;;) {
+    uint64_t flags = local_irq_save();
+    struct work *list = wq->head;
+    wq->head = NULL;
+    wq->tail = &wq->head;
+    if (!list)
+      current_task->state = TASK_BLOCKED;
+    local_irq_restore(flags);
+
+    if (!list) {
+      schedule();
+      continue;
+    }
+
+    while (list) {
+      struct work *work = list;
+      list = work->next;
+      __atomic_store_n(&work->pending, 0, __ATOMIC_RELEASE);
+      work->func(work);
+      wq->executed++;
+    }
+    yield();
+  }
+}
+
+workqueue_t *workqueue_create(const char *name) {
+  if (workqueue_count >= MAX_WORKQUEUES)
+    return NULL;
+
+  workqueue_t *wq = (workqueue_t *)malloc(sizeof(workqueue_t));
+  if (!wq)
+    return NULL;
+
+  wq->name = name;
+  wq->head = NULL;
+  wq->tail = &wq->head;
+  wq->executed = 0;
+  workqueues[workqueue_count++] = wq;
+
+  wq->worker = process_create(worker_thread, name);
+  if (!wq->worker) {
+    workqueue_count--;
+    free(wq);
+    return NULL;
+  }
+  return wq;
+}
+
+void workqueue_init(void) {
+  system_wq = workqueue_create("kworker");
+  if (system_wq) {
+    printk(PRINTK_INFO, "WORKQUEUE: System workqueue started.\n");
+  } else {
+    printk(PRINTK_ERR, "WORKQUEUE: Failed to start system workqueue!\n");
+  }
+}
+
+void work_init(struct work *work, void (*func)(struct work *work)) {
+  work->next = NULL;
+  work->func = func;
+  work->pending = 0;
+}
+
+int queue_work(workqueue_t *wq, struct work *work) {
+  if (!wq)
+    return 0;
+  if (__atomic_exchange_n(&work->pending, 1, __ATOMIC_ACQ_REL))
+    return 0;
+
+  uint64_t flags = local_irq_save();
+  work->next = NULL;
+  *wq->tail = work;
+  wq->tail = &work->next;
+  process_wake(wq->worker);
+  local_irq_restore(flags);
+  return 1;
+}
+
+void flush_workqueue(workqueue_t *wq) {
+  if (!wq)
+    return;
+  while (__atomic_load_n(&wq->head, __ATOMIC_ACQUIRE) ||
+         wq->worker->state == TASK_READY) {
+    yield();
+  }
+}
@@ -0,0 +1,30 @@
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include "process.h"
+#include <stdint.h>
+
+struct work {
+  struct work *next;
+  void (*func)(struct work *work);
+  uint32_t pending;
+};
+
+typedef struct workqueue {
+  const char *name;
+  struct work *head;
+  struct work **tail;
+  task_t *worker;
+  uint64_t executed;
+} workqueue_t;
+
+extern workqueue_t *system_wq;
+
+void workqueue_init(void);
+workqueue_t *workqueue_create(const char *name);
+
+void work_init(struct work *work, void (*func)(struct work *work));
+int queue_work(workqueue_t *wq, struct work *work);
+void flush_workqueue(workqueue_t *wq);
+
+#endif